@@ -7,7 +7,8 @@ flags = [
 '-Werror',
 '-std=c11',
 '-I.',
-'-Iinclude'
+'-Iinclude',
+'-Ibuild/gen'
 ]
 
 def FlagsForFile(filename):
@@ -0,0 +1,103 @@
+#include "utf_props.h"
+#include "utf_props_table.h"
+#include "utf_width_table.h"
+#include "macros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Reports the size of the generated property tables and the cost of
+// looking codepoints up in them.
+
+#define N_CPS (1u << 20)
+#define ROUNDS 20
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// A mix of ASCII, BMP and supplementary codepoints, in random order
+// so that lookups are not all served from the same table blocks.
+static uint32_t *make_cps(void)
+{
+  uint32_t *cps = malloc(N_CPS * sizeof(*cps));
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < N_CPS; i++) {
+    seed = seed * 1103515245 + 12345;
+    const uint32_t r = seed >> 8;
+    switch (r % 4) {
+      case 0: cps[i] = r % 0x80; break;
+      case 1: cps[i] = r % 0x800; break;
+      case 2: cps[i] = r % 0x10000; break;
+      default: cps[i] = r % 0x110000; break;
+    }
+  }
+  return cps;
+}
+
+static void bench_lookup(const char *name, const uint32_t *cps,
+    uint8_t (*lookup)(uint32_t))
+{
+  unsigned sum = 0;
+  const double start = now_ns();
+  for (int r = 0; r < ROUNDS; r++)
+    for (size_t i = 0; i < N_CPS; i++)
+      sum += lookup(cps[i]);
+  const double ns = (now_ns() - start) / ((double)N_CPS * ROUNDS);
+  printf("%-10s %6.2f ns/lookup  (checksum %u)\n", name, ns, sum);
+}
+
+static uint8_t lookup_category(uint32_t cp)
+{
+  return utf_cp_category(cp);
+}
+
+static uint8_t lookup_script(uint32_t cp)
+{
+  return utf_cp_script(cp);
+}
+
+static void bench_classify(const char *name, const void *mem, size_t len,
+    utf_enc_t enc, uint8_t *out)
+{
+  size_t n = 0;
+  const double start = now_ns();
+  for (int r = 0; r < ROUNDS; r++)
+    utf_classify(mem, len, enc, UTF_PROP_CATEGORY, out, N_CPS, &n);
+  const double ns = (now_ns() - start) / ((double)n * ROUNDS);
+  printf("%-10s %6.2f ns/codepoint\n", name, ns);
+}
+
+int main(void)
+{
+  printf("table      bytes\n");
+  printf("%-10s %6d\n", "category", UTF_CATEGORY_BYTES);
+  printf("%-10s %6d\n", "script", UTF_SCRIPT_BYTES);
+  printf("%-10s %6d\n\n", "width", UTF_WIDTH_BYTES);
+
+  uint32_t *cps = make_cps();
+  uint8_t *out = malloc(N_CPS);
+
+  bench_lookup("category", cps, lookup_category);
+  bench_lookup("script", cps, lookup_script);
+  bench_lookup("width", cps, utf_width_lookup);
+
+  for (size_t i = 0; i < N_CPS; i++)
+    if (cps[i] >= 0xD800 && cps[i] <= 0xDFFF)
+      cps[i] = 0xFFFD;
+  bench_classify("utf32", cps, N_CPS * sizeof(*cps), UTF_32, out);
+
+  char *ascii = malloc(N_CPS);
+  for (size_t i = 0; i < N_CPS; i++)
+    ascii[i] = 0x20 + cps[i] % 0x5f;
+  bench_classify("ascii", ascii, N_CPS, UTF_8, out);
+
+  free(ascii);
+  free(out);
+  free(cps);
+  return 0;
+}
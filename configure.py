@@ -9,8 +9,10 @@ cflags += "-std=c11 -fcolor-diagnostics"
 ninja_vars = {
   "builddir" : "build",
   "cc" : "clang",
-  "cflags" : "-g -Wall -Wextra -Wpedantic -Werror -Wno-gnu-zero-variadic-macro-arguments -std=c11 -fcolor-diagnostics",
-  "ldflags" : "-L$builddir",
+  "cflags" : "-g -Wall -Wextra -Wpedantic -Werror -Wno-gnu-zero-variadic-macro-arguments -std=c11 -fcolor-diagnostics -I$builddir/gen",
+  "cxx" : "clang++",
+  "cxxflags" : "-g -Wall -Wextra -Werror -std=c++20 -fcolor-diagnostics -I$builddir/gen",
+  "ldflags" : "-L$builddir -pthread",
 }
 
 ninjafile_base = """
@@ -20,10 +22,24 @@ rule cc
   depfile = $out.d
   deps = gcc
 
+rule cxx
+  command = $cxx -MMD -MT $out -MF $out.d $cxxflags -c $in -o $out
+  description = CXX $out
+  depfile = $out.d
+  deps = gcc
+
 rule link
   command = $cc $ldflags -o $out $in
   description = LINK $out
 
+rule linkxx
+  command = $cxx $ldflags -o $out $in
+  description = LINK $out
+
+rule gen
+  command = python3 ucdgen.py $table $out
+  description = GEN $out
+
 """
 
 def get_san_flags(desc):
@@ -38,17 +54,18 @@ def get_san_flags(desc):
       flags += " -fno-sanitize-recover=undefined"
   return flags
 
-def strip_c_ext(c_file):
-  parts = c_file.split(".")
-  if len(parts) != 2 or parts[1] != "c":
+def split_src_ext(src_file):
+  parts = src_file.split(".")
+  if len(parts) != 2 or parts[1] not in ("c", "cpp"):
     return None
-  return parts[0]
+  return parts[0], parts[1]
 
 class BuildEnv:
   def __init__(self, vars):
     self.vars = vars
     self.progs = []
     self.objs = []
+    self.gens = []
 
   def IsWindows(self):
       return os.name == 'nt'
@@ -56,15 +73,21 @@ class BuildEnv:
   def Program(self, name, src):
     objects = []
     for f in src:
-      obj_name = strip_c_ext(f)
-      objects.append(obj_name)
-      if obj_name not in self.objs:
-        self.objs.append(obj_name)
+      obj = split_src_ext(f)
+      objects.append(obj)
+      if obj not in self.objs:
+        self.objs.append(obj)
     self.progs.append((name, objects))
   
+  def Generated(self, header, table, inputs):
+    self.gens.append((header, table, inputs))
+
   def Test(self, name, src):
     return self.Program("test/%s" % name, src + ["test.c"])
 
+  def Bench(self, name, src):
+    return self.Program("bench/%s" % name, src)
+
   def write_ninja(self, fp):
     fp.write("# auto-generated by configure.py\n")
 
@@ -73,15 +96,27 @@ class BuildEnv:
 
     fp.write(ninjafile_base)
 
-    fp.write("# objects\n")
-    for obj in self.objs:
-      fp.write("build $builddir/%s.o: cc %s.c\n" % (obj, obj))
+    fp.write("# generated tables\n")
+    gen_outs = []
+    for (header, table, inputs) in self.gens:
+      out = "$builddir/gen/%s" % header
+      gen_outs.append(out)
+      fp.write("build %s: gen | ucdgen.py %s\n" % (out, " ".join(inputs)))
+      fp.write("  table = %s\n" % table)
+
+    fp.write("\n# objects\n")
+    order_only = " || " + " ".join(gen_outs) if gen_outs else ""
+    for (obj, ext) in self.objs:
+      rule = "cxx" if ext == "cpp" else "cc"
+      fp.write("build $builddir/%s.o: %s %s.%s%s\n" %
+          (obj, rule, obj, ext, order_only))
 
     fp.write("\n# executables\n")
     for (name, objs) in self.progs:
-      obj_line = " ".join(map(lambda x: "$builddir/%s.o" % x, objs))
+      obj_line = " ".join(map(lambda x: "$builddir/%s.o" % x[0], objs))
       ext = ".exe" if self.IsWindows() else ""
-      fp.write("build $builddir/%s%s: link %s\n" % (name, ext, obj_line))
+      rule = "linkxx" if any(e == "cpp" for (_, e) in objs) else "link"
+      fp.write("build $builddir/%s%s: %s %s\n" % (name, ext, rule, obj_line))
 
 
 if __name__ == '__main__':
@@ -91,18 +126,60 @@ if __name__ == '__main__':
   args = parser.parse_args()
   san_flags = get_san_flags(args.sanitizers)
   ninja_vars["cflags"] += san_flags
+  ninja_vars["cxxflags"] += san_flags
   ninja_vars["ldflags"] += san_flags
 
   if args.config == "release":
     ninja_vars["cflags"] += ' -O3'
+    ninja_vars["cxxflags"] += ' -O3'
   else:
     assert args.config == "debug", \
         "Invalid config %s" % args.config
 
   env = BuildEnv(ninja_vars)
+  env.Generated('utf_width_table.h', 'width',
+      ['ucd/EastAsianWidth.txt', 'ucd/DerivedGeneralCategory.txt',
+        'ucd/emoji-data.txt'])
+  env.Generated('utf_props_table.h', 'props',
+      ['ucd/DerivedGeneralCategory.txt', 'ucd/Scripts.txt'])
+  env.Generated('utf_scripts.h', 'scripts', ['ucd/Scripts.txt'])
+  env.Generated('utf_fold_table.h', 'fold', ['ucd/CaseFolding.txt'])
+  env.Generated('utf_legacy_table.h', 'legacy',
+      ['ucd/index-shift_jis.txt', 'ucd/index-euc_kr.txt',
+        'ucd/index-gb18030.txt', 'ucd/index-gb18030-ranges.txt',
+        'ucd/index-big5.txt'])
+  env.Generated('utf_translit_table.h', 'translit',
+      ['ucd/Decomposition.txt', 'ucd/translit-extra.txt'])
+  env.Generated('utf_words_table.h', 'words',
+      ['ucd/WordBreakProperty.txt', 'ucd/DerivedGeneralCategory.txt',
+        'ucd/emoji-data.txt'])
+
+  # utf_buffer.c and what it depends on.
+  utfbuf = ['utf_buffer.c', 'utf_legacy.c', 'utf_translit.c']
+
   env.Test('test_test', ['test_test.c'])
-  env.Test('test_utf_buffer',
-      ['test_utf_buffer.c', 'utf_buffer.c'])
+  env.Test('test_utf_buffer', ['test_utf_buffer.c'] + utfbuf)
+  env.Test('test_utf_str', ['test_utf_str.c', 'utf_str.c'] + utfbuf)
+  env.Test('test_utf_rope', ['test_utf_rope.c', 'utf_rope.c'] + utfbuf)
+  env.Test('test_utf_json', ['test_utf_json.c', 'utf_json.c'] + utfbuf)
+  env.Test('test_utf_printf', ['test_utf_printf.c', 'utf_printf.c'] + utfbuf)
+  env.Test('test_utf_width', ['test_utf_width.c', 'utf_width.c'] + utfbuf)
+  env.Test('test_utf_props', ['test_utf_props.c', 'utf_props.c'] + utfbuf)
+  env.Test('test_utf_set',
+      ['test_utf_set.c', 'utf_set.c', 'utf_props.c'])
+  env.Test('test_utf_fold',
+      ['test_utf_fold.c', 'utf_fold.c'])
+  env.Test('test_utf_words',
+      ['test_utf_words.c', 'utf_words.c'] + utfbuf)
+  env.Test('test_utf_column',
+      ['test_utf_column.c', 'utf_column.c'])
+  env.Test('test_utf_buffer_hpp', ['test_utf_buffer_hpp.cpp'] + utfbuf)
+  env.Test('test_utf_legacy', ['test_utf_legacy.c'] + utfbuf)
+  env.Test('test_utf_translit', ['test_utf_translit.c'] + utfbuf)
+  env.Test('test_utf_shared',
+      ['test_utf_shared.c', 'utf_shared.c', 'utf_printf.c'] + utfbuf)
+
+  env.Bench('bench_utf_props', ['bench_utf_props.c', 'utf_props.c'])
 
   with open("build.ninja", "w") as f:
     env.write_ninja(f)
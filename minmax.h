@@ -1,8 +1,19 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 static inline size_t min_zu(size_t x, size_t y)
 {
   return x < y ? x : y;
 }
+
+static inline uint32_t min_u32(uint32_t x, uint32_t y)
+{
+  return x < y ? x : y;
+}
+
+static inline uint32_t max_u32(uint32_t x, uint32_t y)
+{
+  return x > y ? x : y;
+}
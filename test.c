@@ -8,8 +8,6 @@
 #include <stdbool.h>
 #include <stdarg.h>
 
-extern const test_manifest_t test_manifest_;
-
 static struct {
   bool failed;
   char msg[1024];
@@ -4,6 +4,10 @@
 
 #include <stddef.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef void (*test_fn_t)(void);
 
 typedef struct {
@@ -12,6 +16,8 @@ typedef struct {
   size_t n_fns;
 } test_manifest_t;
 
+extern const test_manifest_t test_manifest_;
+
 #define RUN_TESTS(...)\
   static const test_fn_t test_fns_[] = { __VA_ARGS__ }; \
   const test_manifest_t test_manifest_ = { \
@@ -41,3 +47,7 @@ typedef struct {
 void test_fail(const char *fmt, ...);
 
 int test_main(void);
+
+#ifdef __cplusplus
+}
+#endif
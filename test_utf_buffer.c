@@ -4,6 +4,7 @@
 #include "macros.h"
 
 #include <string.h>
+#include <sys/uio.h>
 
 static void test_overflow_base_cases(void)
 {
@@ -457,17 +458,229 @@ static void test_any_to_any_single_chars(void)
 {
   for (utf_enc_t dst = UTF_8; dst <= UTF_32; dst++) {
     for (utf_enc_t src = UTF_8; src <= UTF_32; src++) {
-      if (dst == UTF_16 && src != UTF_16)
-        continue;
-      if (src == UTF_16 && dst != UTF_16)
-        continue;
-
       any_char_helper(dst, src);
     }
   }
 }
 
-// TODO: test invalid UTF-16.
+static void test_utf32_to_utf8_boundaries(void)
+{
+  // The largest codepoint of each UTF-8 length.
+  static const struct {
+    uint32_t cp;
+    uint8_t u8[4];
+    uint8_t n;
+  } cases[] = {
+    { 0x7f,     { 0x7f },                   1 },
+    { 0x7ff,    { 0xdf, 0xbf },             2 },
+    { 0xffff,   { 0xef, 0xbf, 0xbf },       3 },
+    { 0x10ffff, { 0xf4, 0x8f, 0xbf, 0xbf }, 4 },
+  };
+
+  uint8_t buf[8];
+  utfbuf_t ub;
+
+  for (size_t i = 0; i < ARRAY_LENGTH(cases); i++) {
+    memset(buf, 0xff, sizeof(buf));
+    utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+    ASSERT_EQ(utfbuf_write_utf32(&ub, cases[i].cp), UTF_ERROR_SUCCESS);
+    ASSERT_EQ(memcmp(buf, cases[i].u8, cases[i].n), 0);
+    ASSERT_EQ(buf[cases[i].n], 0x0);
+  }
+}
+
+static void test_invalid_scalars(void)
+{
+  uint8_t buf[16];
+  utfbuf_t ub;
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_16);
+
+  ASSERT_EQ(utfbuf_write_utf32(&ub, 0xD800),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(utfbuf_write_utf32(&ub, 0x110000),
+      UTF_ERROR_INVALID_ARGUMENT);
+
+  // Lone low surrogate.
+  ASSERT_EQ(utfbuf_write_utf16(&ub, 0xDC00),
+      UTF_ERROR_INVALID_ARGUMENT);
+
+  // High surrogate followed by a non-surrogate.
+  ASSERT_EQ(utfbuf_write_utf16(&ub, 0xD83E), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_write_utf16(&ub, 'a'),
+      UTF_ERROR_INVALID_ARGUMENT);
+
+  // Overlong and surrogate UTF-8 sequences.
+  ASSERT_EQ(utfbuf_write_utf8(&ub, 0xc0), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_write_utf8(&ub, 0x80),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(utfbuf_write_utf8(&ub, 0xed), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_write_utf8(&ub, 0xa0), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_write_utf8(&ub, 0x80),
+      UTF_ERROR_INVALID_ARGUMENT);
+
+  ASSERT_EQ(utfbuf_length(&ub), 0);
+  ASSERT_EQ(buf[0], 0x0);
+  ASSERT_EQ(buf[1], 0x0);
+}
+
+static void test_write_mem(void)
+{
+  static const uint16_t src[] = {
+    'a', 0xE9, 0xD83E, 0xDD84, 'b',
+  };
+  static const uint8_t expect[] = {
+    'a', 0xC3, 0xA9, 0xF0, 0x9F, 0xA6, 0x84, 'b',
+  };
+
+  uint8_t buf[32];
+  memset(buf, 0xff, sizeof(buf));
+
+  utfbuf_t ub;
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write(&ub, src, sizeof(src), UTF_16),
+      UTF_ERROR_SUCCESS);
+
+  ASSERT_EQ(utfbuf_length(&ub), sizeof(expect));
+  ASSERT_EQ(memcmp(buf, expect, sizeof(expect)), 0);
+  ASSERT_EQ(buf[sizeof(expect)], 0x0);
+
+  // Odd byte count for a UTF-16 source.
+  ASSERT_EQ(utfbuf_write(&ub, src, 3, UTF_16),
+      UTF_ERROR_INVALID_ARGUMENT);
+
+  // Counting buffer sees the whole input.
+  utfbuf_init(&ub, NULL, 0, UTF_32);
+  ASSERT_EQ(utfbuf_write(&ub, src, sizeof(src), UTF_16),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_overflow(&ub), 5 * 4);
+}
+
+static size_t gather(const struct iovec *iov, size_t n,
+    uint8_t *out)
+{
+  size_t len = 0;
+  for (size_t i = 0; i < n; i++) {
+    memcpy(out + len, iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+  return len;
+}
+
+static void test_segmented_no_split(void)
+{
+  // "a♪♪b" is 1 + 3 + 3 + 1 bytes; with 4-byte segments the second
+  // quaver cannot share a segment with the first.
+  const char *text = "a\xe2\x99\xaa\xe2\x99\xaa" "b";
+  uint8_t pages[4][4];
+  memset(pages, 0xff, sizeof(pages));
+
+  struct iovec iov[4];
+  for (size_t i = 0; i < ARRAY_LENGTH(iov); i++)
+    iov[i] = (struct iovec){ pages[i], sizeof(pages[i]) };
+
+  utfbuf_t ub;
+  ASSERT_EQ(utfbuf_init_segmented(&ub, iov, ARRAY_LENGTH(iov), UTF_8, 0),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_write_utf8_string(&ub, text), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_overflow(&ub), 0);
+  ASSERT_EQ(utfbuf_length(&ub), 8);
+
+  size_t n;
+  const struct iovec *out = utfbuf_finish_segments(&ub, &n);
+  ASSERT_EQ(out == iov, 1);
+  ASSERT_EQ(n, 2);
+  ASSERT_EQ(iov[0].iov_len, 4);
+  ASSERT_EQ(iov[1].iov_len, 4);
+  ASSERT_EQ(pages[1][0], 0xe2);
+
+  uint8_t flat[16];
+  ASSERT_EQ(gather(out, n, flat), 8);
+  ASSERT_EQ(memcmp(flat, text, 8), 0);
+}
+
+static void test_segmented_split(void)
+{
+  static const uint32_t text[] = { 0x1F984, 'x', 0x266A };
+  uint8_t pages[3][3];
+
+  struct iovec iov[3];
+  for (size_t i = 0; i < ARRAY_LENGTH(iov); i++)
+    iov[i] = (struct iovec){ pages[i], sizeof(pages[i]) };
+
+  utfbuf_t ub;
+  ASSERT_EQ(utfbuf_init_segmented(&ub, iov, ARRAY_LENGTH(iov), UTF_8,
+        UTFBUF_SEG_SPLIT), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_write(&ub, text, sizeof(text), UTF_32),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_overflow(&ub), 0);
+
+  size_t n;
+  const struct iovec *out = utfbuf_finish_segments(&ub, &n);
+  ASSERT_EQ(n, 3);
+  ASSERT_EQ(iov[2].iov_len, 2);
+
+  uint8_t flat[16];
+  ASSERT_EQ(gather(out, n, flat), 8);
+  ASSERT_EQ(memcmp(flat, "\xf0\x9f\xa6\x84x\xe2\x99\xaa", 8), 0);
+}
+
+static void test_segmented_overflow(void)
+{
+  uint16_t page[2];
+  struct iovec iov[1] = { { page, sizeof(page) } };
+
+  utfbuf_t ub;
+  ASSERT_EQ(utfbuf_init_segmented(&ub, iov, 1, UTF_16, 0),
+      UTF_ERROR_SUCCESS);
+
+  // 'a' fits, the surrogate pair does not, and 'b' (which would fit)
+  // is dropped too so the output stays a prefix.
+  ASSERT_EQ(utfbuf_write_utf32(&ub, 'a'), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_write_utf32(&ub, 0x1F984), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_write_utf32(&ub, 'b'), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_overflow(&ub), 6);
+
+  size_t n;
+  utfbuf_finish_segments(&ub, &n);
+  ASSERT_EQ(n, 1);
+  ASSERT_EQ(iov[0].iov_len, 2);
+  ASSERT_EQ(page[0], 'a');
+
+  // Nothing written: no segments used.
+  iov[0].iov_len = sizeof(page);
+  utfbuf_init_segmented(&ub, iov, 1, UTF_16, 0);
+  utfbuf_finish_segments(&ub, &n);
+  ASSERT_EQ(n, 0);
+}
+
+static void test_write_ascii(void)
+{
+  uint16_t buf16[4];
+  memset(buf16, 0xff, sizeof(buf16));
+
+  utfbuf_t ub;
+  utfbuf_init(&ub, buf16, sizeof(buf16), UTF_16);
+  ASSERT_EQ(utfbuf_write_ascii(&ub, "abcde", 5), UTF_ERROR_SUCCESS);
+
+  // Three characters plus the terminator fit.
+  ASSERT_EQ(buf16[0], 'a');
+  ASSERT_EQ(buf16[2], 'c');
+  ASSERT_EQ(buf16[3], 0x0);
+  ASSERT_EQ(utfbuf_overflow(&ub), 4);
+  ASSERT_EQ(utfbuf_truncated(&ub), 1);
+
+  utfbuf_init(&ub, NULL, 0, UTF_32);
+  ASSERT_EQ(utfbuf_write_ascii(&ub, "abcde", 5), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_overflow(&ub), 24);
+  ASSERT_EQ(utfbuf_truncated(&ub), 0);
+
+  // Not allowed mid-codepoint.
+  uint8_t buf[8];
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_utf8(&ub, 0xc3), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_write_ascii(&ub, "a", 1),
+      UTF_ERROR_INVALID_ARGUMENT);
+}
 
 RUN_TESTS(
     test_overflow_base_cases,
@@ -479,4 +692,11 @@ RUN_TESTS(
     test_utf8_to_utf32_truncation,
     test_utf32_to_utf8_simple,
     test_any_to_any_single_chars,
+    test_utf32_to_utf8_boundaries,
+    test_invalid_scalars,
+    test_write_mem,
+    test_segmented_no_split,
+    test_segmented_split,
+    test_segmented_overflow,
+    test_write_ascii,
 )
@@ -0,0 +1,108 @@
+#include "utf_buffer.hpp"
+
+#include "test.h"
+
+#include <cstring>
+#include <cwchar>
+#include <string>
+#include <vector>
+
+// Checked at compile time.
+static_assert(utf::transcode<UTF_16>("h\xc3\xa9").size() == 2);
+static_assert(utf::transcode<UTF_16>("h\xc3\xa9").data()[1] == 0xE9);
+static_assert(utf::transcode<UTF_32>(u"\xD83D\xDE00").data()[0] == 0x1F600);
+static_assert(utf::transcode<UTF_8>(U"€").size() == 3);
+static_assert(utf::literal<UTF_16, "\xf0\x9f\x98\x80">.size() == 3);
+static_assert(utf::literal<UTF_32, u8"café">.size() == 5);
+
+// Supplementary characters from UTF-32 take two UTF-16 units each.
+static_assert(utf::transcode<UTF_16>(U"\U0001F600\U0001F600").size() == 4);
+static_assert(utf::transcode<UTF_16>(U"\U0001F600\U0001F600").data()[3]
+    == 0xDE00);
+static_assert(utf::literal<UTF_16, U"a\U0001F600">.size() == 4);
+#if WCHAR_MAX > 0xFFFF
+static_assert(utf::transcode<UTF_16>(L"\U0001F600\U0001F600").size() == 4);
+static_assert(utf::literal<UTF_16, L"\U0001F600">[1] == 0xDE00);
+#endif
+
+static void test_transcode_literals(void)
+{
+  static constexpr auto u16 = utf::transcode<UTF_16>("na\xc3\xafve \xf0\x9f\x98\x80");
+  const char16_t expect16[] = u"naïve \U0001F600";
+  ASSERT_EQ(u16.size(), 8);
+  ASSERT_EQ(std::memcmp(u16.data(), expect16, sizeof(expect16)), 0);
+  ASSERT_EQ(u16.c_str()[u16.size()], 0);
+
+  static constexpr auto &u32 = utf::literal<UTF_32, u"日本">;
+  ASSERT_EQ(u32.size(), 3);
+  ASSERT_EQ(u32[0], 0x65E5);
+  ASSERT_EQ(u32[1], 0x672C);
+  ASSERT_EQ(u32[2], 0);
+
+  static constexpr auto u8 = utf::transcode<UTF_8>(U"é\U0001F600");
+  ASSERT_EQ(u8.view() == std::string_view("\xc3\xa9\xf0\x9f\x98\x80"), true);
+
+  // Built at run time, where a short array would be written past.
+  const auto pairs = utf::transcode<UTF_16>(U"\U0001F600\U0001F984");
+  ASSERT_EQ(pairs.view() == std::u16string_view(u"\U0001F600\U0001F984"),
+      true);
+  ASSERT_EQ(pairs.c_str()[4], 0);
+#if WCHAR_MAX > 0xFFFF
+  const auto wide = utf::transcode<UTF_16>(L"x\U0001F600\U0001F984");
+  ASSERT_EQ(wide.view() == std::u16string_view(u"x\U0001F600\U0001F984"),
+      true);
+#endif
+}
+
+static void test_wrapper_views(void)
+{
+  char16_t mem[32];
+  utf::utfbuf<UTF_16> ub(mem);
+
+  ASSERT_EQ(ub.write(std::string_view("caf\xc3\xa9 ")), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(ub.write(std::u16string_view(u"日")), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(ub.write(std::u32string_view(U"\U0001F600")), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(ub.put(U'!'), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(ub.view() == std::u16string_view(u"café 日\U0001F600!"),
+      true);
+  ASSERT_EQ(ub.overflow(), 0);
+
+  ASSERT_EQ(ub.write(std::string_view("\xff")), UTF_ERROR_INVALID_ARGUMENT);
+}
+
+static void test_wrapper_spans(void)
+{
+  std::vector<char32_t> storage(8);
+  utf::utfbuf<UTF_32> ub{std::span<char32_t>(storage)};
+
+  const std::u16string src = u"aé";
+  ASSERT_EQ(ub.write(std::span<const char16_t>(src)), UTF_ERROR_SUCCESS);
+  const char bytes[] = "\xe2\x82\xac";
+  ASSERT_EQ(ub.write(std::span(bytes, 3)), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(ub.view() == std::u32string_view(U"aé€"), true);
+
+  std::array<char, 16> out;
+  utf::utfbuf<UTF_8> ub8(out);
+  ASSERT_EQ(ub8.write(utf::transcode<UTF_16>("x\xc3\xa9")),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(ub8.view() == "x\xc3\xa9", true);
+}
+
+static void test_measure_and_truncate(void)
+{
+  ASSERT_EQ(utf::measure<UTF_16>(std::string_view("h\xc3\xa9llo")), 12);
+  ASSERT_EQ(utf::measure<UTF_8>(std::u32string_view(U"\U0001F600")), 5);
+
+  char small[4];
+  utf::utfbuf<UTF_8> ub(small);
+  ASSERT_EQ(ub.write(std::u16string_view(u"abcdef")), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(ub.truncated(), true);
+  ASSERT_EQ(ub.view() == "abc", true);
+}
+
+RUN_TESTS(
+    test_transcode_literals,
+    test_wrapper_views,
+    test_wrapper_spans,
+    test_measure_and_truncate,
+)
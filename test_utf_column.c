@@ -0,0 +1,143 @@
+#include "utf_column.h"
+#include "test.h"
+
+#include <string.h>
+
+static void test_ascii_column(void)
+{
+  // Rows: "hello", "", "a column of ascii long enough for vectors".
+  const char data[] = "xxhelloa column of ascii long enough for vectors";
+  const uint32_t offs[] = { 2, 7, 7, 48 };
+  const utf_column_t col = { offs, data, 3, UTF_8 };
+
+  uint32_t out_offs[4];
+  uint16_t out[64];
+  uint8_t errors[1] = { 0xff };
+  size_t len = 0;
+
+  ASSERT_EQ(utf_column_transcode(&col, UTF_16, out_offs, out, sizeof(out),
+        &len, errors), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(len, 46 * 2);
+  ASSERT_EQ(errors[0], 0);
+  ASSERT_EQ(out_offs[0], 0);
+  ASSERT_EQ(out_offs[1], 10);
+  ASSERT_EQ(out_offs[2], 10);
+  ASSERT_EQ(out_offs[3], 92);
+  for (size_t i = 0; i < 46; i++)
+    ASSERT_EQ(out[i], data[2 + i]);
+
+  uint32_t out32[64];
+  ASSERT_EQ(utf_column_transcode(&col, UTF_32, out_offs, out32,
+        sizeof(out32), &len, NULL), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(len, 46 * 4);
+  ASSERT_EQ(out32[45], 's');
+
+  char out8[64];
+  ASSERT_EQ(utf_column_transcode(&col, UTF_8, out_offs, out8,
+        sizeof(out8), &len, NULL), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(len, 46);
+  ASSERT_EQ(memcmp(out8, data + 2, 46), 0);
+}
+
+static void test_mixed_column(void)
+{
+  // Rows: "café", invalid, "\U0001F600!", truncated, "plain".
+  const char data[] = "caf\xc3\xa9" "a\xff" "\xf0\x9f\x98\x80!"
+    "\xe2\x82" "plain";
+  const uint32_t offs[] = { 0, 5, 7, 12, 14, 19 };
+  const utf_column_t col = { offs, data, 5, UTF_8 };
+
+  uint32_t out_offs[6];
+  uint16_t out[16];
+  uint8_t errors[1];
+  size_t len = 0;
+
+  ASSERT_EQ(utf_column_transcode(&col, UTF_16, out_offs, out, sizeof(out),
+        &len, errors), UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(errors[0], 0x0a);
+  ASSERT_EQ(len, (4 + 3 + 5) * 2);
+  const uint32_t expect_offs[] = { 0, 8, 8, 14, 14, 24 };
+  ASSERT_EQ(memcmp(out_offs, expect_offs, sizeof(expect_offs)), 0);
+  const uint16_t expect[] = { 'c', 'a', 'f', 0xE9, 0xD83D, 0xDE00, '!',
+    'p', 'l', 'a', 'i', 'n' };
+  ASSERT_EQ(memcmp(out, expect, sizeof(expect)), 0);
+
+  ASSERT_EQ(utf_column_validate(&col, errors), UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(errors[0], 0x0a);
+}
+
+static void test_wide_sources(void)
+{
+  // UTF-16 rows "été" and "\U0001F600", the second with a
+  // lone surrogate in a third row.
+  const uint16_t data[] = { 0xE9, 't', 0xE9, 0xD83D, 0xDE00, 0xDC00 };
+  const uint32_t offs[] = { 0, 6, 10, 12 };
+  const utf_column_t col = { offs, data, 3, UTF_16 };
+
+  uint32_t out_offs[4];
+  char out[16];
+  uint8_t errors[1];
+  size_t len = 0;
+
+  ASSERT_EQ(utf_column_transcode(&col, UTF_8, out_offs, out, sizeof(out),
+        &len, errors), UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(errors[0], 0x4);
+  ASSERT_EQ(len, 9);
+  ASSERT_EQ(out_offs[1], 5);
+  ASSERT_EQ(out_offs[3], 9);
+  ASSERT_EQ(memcmp(out, "\xc3\xa9t\xc3\xa9\xf0\x9f\x98\x80", 9), 0);
+
+  // Odd byte lengths and decreasing offsets are row errors.
+  const uint32_t bad_offs[] = { 0, 3, 2, 6 };
+  const utf_column_t bad = { bad_offs, data, 3, UTF_16 };
+  ASSERT_EQ(utf_column_validate(&bad, errors), UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(errors[0], 0x3);
+
+  const uint32_t data32[] = { 'a', 0x110000, 0x1F600 };
+  const uint32_t offs32[] = { 0, 4, 8, 12 };
+  const utf_column_t col32 = { offs32, data32, 3, UTF_32 };
+  ASSERT_EQ(utf_column_transcode(&col32, UTF_16, out_offs, out,
+        sizeof(out), &len, errors), UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(errors[0], 0x2);
+  ASSERT_EQ(len, 6);
+}
+
+static void test_sizing(void)
+{
+  const char data[] = "one" "tw\xc3\xb6" "three";
+  const uint32_t offs[] = { 0, 3, 7, 12 };
+  const utf_column_t col = { offs, data, 3, UTF_8 };
+
+  uint32_t out_offs[4];
+  size_t len = 0;
+  ASSERT_EQ(utf_column_transcode(&col, UTF_32, out_offs, NULL, 0,
+        &len, NULL), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(len, 11 * 4);
+  ASSERT_EQ(out_offs[2], 24);
+
+  // A short buffer holds a prefix; the offsets are still complete.
+  uint32_t out[8];
+  memset(out, 0, sizeof(out));
+  ASSERT_EQ(utf_column_transcode(&col, UTF_32, out_offs, out,
+        sizeof(out), &len, NULL), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(len, 11 * 4);
+  ASSERT_EQ(out_offs[3], 44);
+  ASSERT_EQ(out[5], 0xF6);
+  ASSERT_EQ(out[7], 'h');
+
+  // Same for the all-ASCII path.
+  const uint32_t ascii_offs[] = { 7, 12 };
+  const utf_column_t ascii = { ascii_offs, data, 1, UTF_8 };
+  char out8[3];
+  ASSERT_EQ(utf_column_transcode(&ascii, UTF_8, out_offs, out8,
+        sizeof(out8), &len, NULL), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(len, 5);
+  ASSERT_EQ(memcmp(out8, "thr", 3), 0);
+}
+
+RUN_TESTS(
+    test_ascii_column,
+    test_mixed_column,
+    test_wide_sources,
+    test_sizing,
+)
@@ -0,0 +1,120 @@
+#include "utf_fold.h"
+#include "test.h"
+
+#include <string.h>
+
+static void test_cp_fold(void)
+{
+  uint32_t out[3];
+  ASSERT_EQ(utf_cp_fold('A', out), 1);
+  ASSERT_EQ(out[0], 'a');
+  ASSERT_EQ(utf_cp_fold('a', out), 1);
+  ASSERT_EQ(out[0], 'a');
+  ASSERT_EQ(utf_cp_fold(0x0416, out), 1);   // Ж
+  ASSERT_EQ(out[0], 0x0436);
+  ASSERT_EQ(utf_cp_fold(0x212A, out), 1);   // KELVIN SIGN
+  ASSERT_EQ(out[0], 'k');
+  ASSERT_EQ(utf_cp_fold(0x00DF, out), 2);   // ß
+  ASSERT_EQ(out[0], 's');
+  ASSERT_EQ(out[1], 's');
+  ASSERT_EQ(utf_cp_fold(0xFB03, out), 3);   // ﬃ
+  ASSERT_EQ(out[2], 'i');
+  ASSERT_EQ(utf_cp_fold(0x10400, out), 1);  // 𐐀
+  ASSERT_EQ(out[0], 0x10428);
+  ASSERT_EQ(utf_cp_fold(0x4E00, out), 1);
+  ASSERT_EQ(out[0], 0x4E00);
+}
+
+static void to_utf16(const char *s, uint16_t *out, size_t *len)
+{
+  // ASCII plus a few escapes: enough for these tests.
+  size_t n = 0;
+  for (; *s; s++) {
+    const uint8_t c = (uint8_t)*s;
+    if (c < 0x80) {
+      out[n++] = c;
+    } else if ((c & 0xe0) == 0xc0) {
+      out[n++] = ((c & 0x1f) << 6) | (s[1] & 0x3f);
+      s += 1;
+    } else {
+      out[n++] = ((c & 0x0f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f);
+      s += 2;
+    }
+  }
+  *len = n * 2;
+}
+
+static void test_equal_folded(void)
+{
+  ASSERT_EQ(utf_equal_folded("Hello", 5, UTF_8, "hELLO", 5, UTF_8), 1);
+  ASSERT_EQ(utf_equal_folded("Hello", 5, UTF_8, "hELLo!", 6, UTF_8), 0);
+  ASSERT_EQ(utf_equal_folded("", 0, UTF_8, "", 0, UTF_16), 1);
+
+  // Straße / STRASSE: one side folds to more codepoints.
+  const char *strasse = "Stra\xc3\x9f" "e";
+  ASSERT_EQ(utf_equal_folded(strasse, 7, UTF_8, "STRASSE", 7, UTF_8), 1);
+  ASSERT_EQ(utf_equal_folded("STRASSE", 7, UTF_8, strasse, 7, UTF_8), 1);
+  ASSERT_EQ(utf_equal_folded(strasse, 7, UTF_8, "STRASE", 6, UTF_8), 0);
+
+  // Across encodings and past the vector width.
+  const char *long8 = "The Quick Brown Fox Jumps Over \xc3\x89milie's Lazy Dog";
+  uint16_t long16[64];
+  size_t len16;
+  to_utf16("the quick brown fox jumps over \xc3\xa9MILIE'S LAZY DOG",
+      long16, &len16);
+  ASSERT_EQ(utf_equal_folded(long8, strlen(long8), UTF_8,
+        long16, len16, UTF_16), 1);
+  long16[36] = 'X';
+  ASSERT_EQ(utf_equal_folded(long8, strlen(long8), UTF_8,
+        long16, len16, UTF_16), 0);
+
+  const uint32_t k32[] = { 0x212A, 'E', 'L', 'V', 'I', 'N' };
+  ASSERT_EQ(utf_equal_folded(k32, sizeof(k32), UTF_32, "kelvin", 6, UTF_8),
+      1);
+
+  ASSERT_EQ(utf_equal_folded("a\xff", 2, UTF_8, "a\xff", 2, UTF_8), 0);
+}
+
+static void test_hash_folded(void)
+{
+  const char *mixed = "The Quick Brown Fox Jumps Over \xc3\x89milie's "
+    "Stra\xc3\x9f" "e";
+  const char *folded = "the quick brown fox jumps over \xc3\xa9milie's "
+    "strasse";
+  const uint64_t h = utf_hash_folded(mixed, strlen(mixed), UTF_8, 7);
+  ASSERT_EQ(h == utf_hash_folded(folded, strlen(folded), UTF_8, 7), 1);
+  ASSERT_EQ(h == utf_hash_folded(folded, strlen(folded), UTF_8, 8), 0);
+  ASSERT_EQ(h == utf_hash_folded(folded, strlen(folded) - 1, UTF_8, 7), 0);
+
+  uint16_t s16[64];
+  size_t len16;
+  to_utf16(mixed, s16, &len16);
+  ASSERT_EQ(h == utf_hash_folded(s16, len16, UTF_16, 7), 1);
+
+  uint32_t s32[64];
+  for (size_t i = 0; i < len16 / 2; i++)
+    s32[i] = s16[i];
+  ASSERT_EQ(h == utf_hash_folded(s32, len16 * 2, UTF_32, 7), 1);
+
+  // Every split of the input between the vector and scalar paths
+  // hashes the same.
+  char buf[64];
+  for (size_t at = 0; at < 40; at++) {
+    memset(buf, 'a', sizeof(buf));
+    memcpy(buf + at, "\xc3\x89", 2);
+    char ref[64];
+    memset(ref, 'A', sizeof(ref));
+    memcpy(ref + at, "\xc3\xa9", 2);
+    ASSERT_EQ(utf_hash_folded(buf, sizeof(buf), UTF_8, 0) ==
+        utf_hash_folded(ref, sizeof(ref), UTF_8, 0), 1);
+  }
+
+  ASSERT_EQ(utf_hash_folded("a", 1, UTF_8, 0) ==
+      utf_hash_folded("b", 1, UTF_8, 0), 0);
+}
+
+RUN_TESTS(
+    test_cp_fold,
+    test_equal_folded,
+    test_hash_folded,
+)
@@ -0,0 +1,153 @@
+#include "utf_json.h"
+#include "test.h"
+#include "macros.h"
+
+#include <string.h>
+
+static void test_json_unescape_simple(void)
+{
+  const char *in = "plain text that is longer than one vector "
+    "\\\"quoted\\\" \\\\ \\/ \\b\\f\\n\\r\\t done";
+  const char *expect = "plain text that is longer than one vector "
+    "\"quoted\" \\ / \b\f\n\r\t done";
+
+  char buf[128];
+  utfbuf_t ub;
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_json_unescaped(&ub, in, strlen(in)),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(buf, expect), 0);
+}
+
+static void test_json_unescape_surrogates(void)
+{
+  // An escaped surrogate pair, a BMP escape and raw UTF-8, decoded
+  // into each encoding.
+  const char *in = "\\uD83D\\uDE00 \\u00e9 \xe2\x99\xaa";
+  static const uint32_t expect[] = {
+    0x1F600, ' ', 0xE9, ' ', 0x266A,
+  };
+
+  uint32_t buf[16];
+  utfbuf_t ub;
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_32);
+  ASSERT_EQ(utfbuf_write_json_unescaped(&ub, in, strlen(in)),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(memcmp(buf, expect, sizeof(expect)), 0);
+  ASSERT_EQ(buf[ARRAY_LENGTH(expect)], 0);
+
+  uint16_t buf16[16];
+  utfbuf_init(&ub, buf16, sizeof(buf16), UTF_16);
+  ASSERT_EQ(utfbuf_write_json_unescaped(&ub, in, strlen(in)),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(buf16[0], 0xD83D);
+  ASSERT_EQ(buf16[1], 0xDE00);
+  ASSERT_EQ(buf16[3], 0xE9);
+
+  char buf8[16];
+  utfbuf_init(&ub, buf8, sizeof(buf8), UTF_8);
+  ASSERT_EQ(utfbuf_write_json_unescaped(&ub, in, strlen(in)),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(buf8, "\xf0\x9f\x98\x80 \xc3\xa9 \xe2\x99\xaa"), 0);
+}
+
+static void test_json_unescape_invalid(void)
+{
+  static const char *cases[] = {
+    "\\uD83D",          // dangling high surrogate
+    "\\uD83Dx",         // high surrogate then text
+    "\\uDE00",          // lone low surrogate
+    "\\u12",            // short escape
+    "\\u12G4",          // bad hex digit
+    "\\x",              // unknown escape
+    "\\",               // trailing backslash
+    "a\"b",             // unescaped quote
+    "a\nb",             // raw control character
+    "\xc3",             // truncated UTF-8
+  };
+
+  char buf[32];
+  utfbuf_t ub;
+
+  for (size_t i = 0; i < ARRAY_LENGTH(cases); i++) {
+    utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+    ASSERT_EQ(utfbuf_write_json_unescaped(&ub, cases[i],
+          strlen(cases[i])), UTF_ERROR_INVALID_ARGUMENT);
+  }
+
+  // A failure after a high surrogate leaves nothing pending in the
+  // buffer, whatever the error.
+  static const char *after_high[] = {
+    "\\uD83D\x01", "\\uD83D\\u12", "\\uD83D\\q", "\\uD83D\xff",
+  };
+  for (size_t i = 0; i < ARRAY_LENGTH(after_high); i++) {
+    utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+    ASSERT_EQ(utfbuf_write_json_unescaped(&ub, after_high[i],
+          strlen(after_high[i])), UTF_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(utfbuf_write_json_unescaped(&ub, "ok", 2), UTF_ERROR_SUCCESS);
+    ASSERT_EQ(strcmp(buf, "ok"), 0);
+  }
+}
+
+static void test_json_escape(void)
+{
+  const char *in = "say \"hi\"\\\n\x01 caf\xc3\xa9 \xf0\x9f\x98\x80";
+
+  char buf[128];
+  utfbuf_t ub;
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_json_escaped(&ub, in, strlen(in), UTF_8, 0),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(buf, "say \\\"hi\\\"\\\\\\n\\u0001 caf\xc3\xa9 "
+        "\xf0\x9f\x98\x80"), 0);
+
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_json_escaped(&ub, in, strlen(in), UTF_8,
+        UTF_JSON_ESCAPE_NON_ASCII), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(buf, "say \\\"hi\\\"\\\\\\n\\u0001 caf\\u00e9 "
+        "\\ud83d\\ude00"), 0);
+
+  // From UTF-16, and round trip back through the unescaper.
+  static const uint16_t in16[] = { 'a', '"', 0xD83D, 0xDE00, '\t' };
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_json_escaped(&ub, in16, sizeof(in16), UTF_16,
+        UTF_JSON_ESCAPE_NON_ASCII), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(buf, "a\\\"\\ud83d\\ude00\\t"), 0);
+
+  uint16_t back[16];
+  utfbuf_t ub16;
+  utfbuf_init(&ub16, back, sizeof(back), UTF_16);
+  ASSERT_EQ(utfbuf_write_json_unescaped(&ub16, buf, strlen(buf)),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(memcmp(back, in16, sizeof(in16)), 0);
+}
+
+static void test_json_sizing(void)
+{
+  // The counting-buffer trick sizes the output exactly.
+  const char *in = "line one\nline \"two\" with a long clean tail";
+
+  utfbuf_t ub;
+  utfbuf_init(&ub, NULL, 0, UTF_16);
+  ASSERT_EQ(utfbuf_write_json_escaped(&ub, in, strlen(in), UTF_8, 0),
+      UTF_ERROR_SUCCESS);
+
+  const size_t escaped_len = strlen(in) + 3;
+  ASSERT_EQ(utfbuf_overflow(&ub), 2 * (escaped_len + 1));
+
+  // A short buffer keeps a prefix.
+  char buf[8];
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_json_escaped(&ub, in, strlen(in), UTF_8, 0),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(buf, "line on"), 0);
+  ASSERT_EQ(utfbuf_truncated(&ub), 1);
+}
+
+RUN_TESTS(
+    test_json_unescape_simple,
+    test_json_unescape_surrogates,
+    test_json_unescape_invalid,
+    test_json_escape,
+    test_json_sizing,
+)
@@ -0,0 +1,174 @@
+#include "utf_legacy.h"
+#include "utf_codec.h"
+#include "test.h"
+
+#include <string.h>
+
+static const utf_enc_t encodings[] = {
+  UTF_SHIFT_JIS, UTF_EUC_KR, UTF_GB18030, UTF_BIG5,
+};
+
+static int decode(utf_enc_t enc, const char *s, size_t n, uint32_t *cp)
+{
+  return utf_legacy_decode(enc, (const uint8_t *)s, n, cp);
+}
+
+static void test_decode(void)
+{
+  uint32_t cp = 0;
+
+  ASSERT_EQ(decode(UTF_SHIFT_JIS, "A", 1, &cp), 1);
+  ASSERT_EQ(cp, 'A');
+  ASSERT_EQ(decode(UTF_SHIFT_JIS, "\x82\xa0", 2, &cp), 2);  // あ
+  ASSERT_EQ(cp, 0x3042);
+  ASSERT_EQ(decode(UTF_SHIFT_JIS, "\x83\x5c", 2, &cp), 2);  // ソ
+  ASSERT_EQ(cp, 0x30BD);
+  ASSERT_EQ(decode(UTF_SHIFT_JIS, "\xb1", 1, &cp), 1);      // ｱ
+  ASSERT_EQ(cp, 0xFF71);
+  ASSERT_EQ(decode(UTF_EUC_KR, "\xb0\xa1", 2, &cp), 2);     // 가
+  ASSERT_EQ(cp, 0xAC00);
+  ASSERT_EQ(decode(UTF_GB18030, "\xc4\xe3", 2, &cp), 2);    // 你
+  ASSERT_EQ(cp, 0x4F60);
+  ASSERT_EQ(decode(UTF_BIG5, "\xa4\x40", 2, &cp), 2);       // 一
+  ASSERT_EQ(cp, 0x4E00);
+
+  // GB18030 four-byte sequences, in and past the BMP.
+  ASSERT_EQ(decode(UTF_GB18030, "\x81\x30\x81\x30", 4, &cp), 4);
+  ASSERT_EQ(cp, 0x80);
+  ASSERT_EQ(decode(UTF_GB18030, "\x84\x31\xa4\x39", 4, &cp), 4);
+  ASSERT_EQ(cp, 0xFFFF);
+  ASSERT_EQ(decode(UTF_GB18030, "\x90\x30\x81\x30", 4, &cp), 4);
+  ASSERT_EQ(cp, 0x10000);
+  ASSERT_EQ(decode(UTF_GB18030, "\xe3\x32\x9a\x35", 4, &cp), 4);
+  ASSERT_EQ(cp, 0x10FFFF);
+  ASSERT_EQ(decode(UTF_GB18030, "\xe3\x32\x9a\x36", 4, &cp), -1);
+  ASSERT_EQ(decode(UTF_GB18030, "\x84\x31\xa5\x30", 4, &cp), -1);
+
+  // Incomplete prefixes, then malformed sequences.
+  ASSERT_EQ(decode(UTF_SHIFT_JIS, "\x82", 1, &cp), 0);
+  ASSERT_EQ(decode(UTF_GB18030, "\x81\x30", 2, &cp), 0);
+  ASSERT_EQ(decode(UTF_GB18030, "\x81\x30\x81", 3, &cp), 0);
+  ASSERT_EQ(decode(UTF_SHIFT_JIS, "\x82\x20", 2, &cp), -1);
+  ASSERT_EQ(decode(UTF_GB18030, "\x81\x30\x20", 3, &cp), -1);
+  ASSERT_EQ(decode(UTF_GB18030, "\xff", 1, &cp), -1);
+  ASSERT_EQ(decode(UTF_BIG5, "\x80", 1, &cp), -1);
+  ASSERT_EQ(decode(UTF_EUC_KR, "\xa1\xff", 2, &cp), -1);
+}
+
+static void test_encode(void)
+{
+  uint8_t out[4];
+
+  ASSERT_EQ(utf_legacy_encode(UTF_BIG5, 'z', out), 1);
+  ASSERT_EQ(out[0], 'z');
+  ASSERT_EQ(utf_legacy_encode(UTF_SHIFT_JIS, 0x3042, out), 2);
+  ASSERT_EQ(memcmp(out, "\x82\xa0", 2), 0);
+  ASSERT_EQ(utf_legacy_encode(UTF_SHIFT_JIS, 0xFF71, out), 1);
+  ASSERT_EQ(out[0], 0xb1);
+  ASSERT_EQ(utf_legacy_encode(UTF_EUC_KR, 0xAC00, out), 2);
+  ASSERT_EQ(memcmp(out, "\xb0\xa1", 2), 0);
+  ASSERT_EQ(utf_legacy_encode(UTF_GB18030, 0xE9, out), 2);
+  ASSERT_EQ(memcmp(out, "\xa8\xa6", 2), 0);
+  ASSERT_EQ(utf_legacy_encode(UTF_GB18030, 0x1F600, out), 4);
+  ASSERT_EQ(memcmp(out, "\x94\x39\xfc\x36", 4), 0);
+
+  // No mapping.
+  ASSERT_EQ(utf_legacy_encode(UTF_SHIFT_JIS, 0xAC00, out), 0);
+  ASSERT_EQ(utf_legacy_encode(UTF_BIG5, 0x1F600, out), 0);
+  ASSERT_EQ(utf_legacy_encode(UTF_EUC_KR, 0xFFFF, out), 0);
+  ASSERT_EQ(utf_legacy_encode(UTF_GB18030, 0xD800, out), 0);
+}
+
+static void test_round_trip(void)
+{
+  // Whatever encodes decodes back, and all of Unicode encodes in
+  // GB18030.
+  for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+    const utf_enc_t enc = encodings[e];
+    size_t mapped = 0;
+
+    for (uint32_t c = 0; c <= 0x10FFFF; c++) {
+      uint8_t out[4];
+      uint32_t back = 0;
+      const size_t n = utf_legacy_encode(enc, c, out);
+      if (!n) {
+        ASSERT_EQ(enc == UTF_GB18030 && utf_is_scalar(c), 0);
+        continue;
+      }
+      mapped++;
+      ASSERT_EQ(utf_legacy_decode(enc, out, n, &back), (int)n);
+      ASSERT_EQ(back, c);
+    }
+
+    ASSERT_EQ(mapped > 9000, 1);
+  }
+}
+
+static void test_write_from_legacy(void)
+{
+  UTFBUF_DEFINE_LOCAL(ub, 64, UTF_8);
+
+  // A character split across calls, and a trail byte which looks
+  // like '\' after an ASCII run longer than a vector.
+  ASSERT_EQ(utfbuf_write(&ub, "abc\x82", 4, UTF_SHIFT_JIS), 0);
+  ASSERT_EQ(utfbuf_length(&ub), 3);
+  ASSERT_EQ(utfbuf_write(&ub, "\xa0" "0123456789abcdef\x83\x5c!", 20,
+        UTF_SHIFT_JIS), 0);
+  ASSERT_EQ(strcmp((const char *)ub_storage,
+        "abc\xe3\x81\x82" "0123456789abcdef\xe3\x82\xbd!"), 0);
+
+  // GB18030 four-byte sequences may be split anywhere.
+  UTFBUF_DEFINE_LOCAL(gb, 16, UTF_32);
+  const char *smile = "\x94\x39\xfc\x36";
+  for (size_t i = 0; i < 4; i++)
+    ASSERT_EQ(utfbuf_write_legacy(&gb, (uint8_t)smile[i], UTF_GB18030), 0);
+  ASSERT_EQ(utfbuf_length(&gb), 4);
+  uint32_t cp;
+  memcpy(&cp, gb_storage, 4);
+  ASSERT_EQ(cp, 0x1F600);
+
+  // Malformed input, and a switch of encoding mid-character.
+  UTFBUF_DEFINE_LOCAL(bad, 16, UTF_8);
+  ASSERT_EQ(utfbuf_write(&bad, "\x82\x20", 2, UTF_SHIFT_JIS),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(utfbuf_write_legacy(&bad, 0x82, UTF_SHIFT_JIS), 0);
+  ASSERT_EQ(utfbuf_write_utf8(&bad, 'a'), UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(utfbuf_write_legacy(&bad, 'a', UTF_8),
+      UTF_ERROR_INVALID_ARGUMENT);
+}
+
+static void test_write_to_legacy(void)
+{
+  // "你好, world" in GB18030.
+  const char *hello = "\xe4\xbd\xa0\xe5\xa5\xbd, world";
+  UTFBUF_DEFINE_LOCAL(ub, 32, UTF_GB18030);
+  ASSERT_EQ(utfbuf_write_utf8_string(&ub, hello), 0);
+  ASSERT_EQ(strcmp((const char *)ub_storage, "\xc4\xe3\xba\xc3, world"), 0);
+  ASSERT_EQ(utfbuf_length(&ub), 11);
+
+  // Counting buffer.
+  utfbuf_t count;
+  ASSERT_EQ(utfbuf_init(&count, NULL, 0, UTF_GB18030), 0);
+  ASSERT_EQ(utfbuf_write_utf8_string(&count, hello), 0);
+  ASSERT_EQ(utfbuf_overflow(&count), 12);
+
+  // Between legacy encodings.
+  UTFBUF_DEFINE_LOCAL(sj, 8, UTF_SHIFT_JIS);
+  ASSERT_EQ(utfbuf_write(&sj, "\xa4\x40", 2, UTF_BIG5), 0);  // 一
+  ASSERT_EQ(strcmp((const char *)sj_storage, "\x88\xea"), 0);
+
+  // Hangul has no Big5 mapping.
+  UTFBUF_DEFINE_LOCAL(big5, 8, UTF_BIG5);
+  ASSERT_EQ(utfbuf_write_utf32(&big5, 0xAC00), UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(utfbuf_length(&big5), 0);
+  ASSERT_EQ(utfbuf_write_utf32(&big5, 0x4E00), 0);
+  ASSERT_EQ(utfbuf_length(&big5), 2);
+}
+
+RUN_TESTS(
+    test_decode,
+    test_encode,
+    test_round_trip,
+    test_write_from_legacy,
+    test_write_to_legacy,
+)
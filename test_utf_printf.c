@@ -0,0 +1,141 @@
+#include "utf_printf.h"
+#include "test.h"
+#include "macros.h"
+
+#include <limits.h>
+#include <string.h>
+
+static void test_printf_numbers(void)
+{
+  char buf[128];
+  utfbuf_t ub;
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+
+  ASSERT_EQ(utfbuf_printf(&ub, "%d|%5u|%-4x|%lld|%zu|%.2f|%%|%*d",
+        -12, 7u, 0xab, -1234567890123LL, (size_t)42, 3.14159, 3, 9),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(buf,
+        "-12|    7|ab  |-1234567890123|42|3.14|%|  9"), 0);
+}
+
+static void test_printf_strings_count_codepoints(void)
+{
+  char buf[128];
+  utfbuf_t ub;
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+
+  // "café" is four codepoints (five bytes): a width of 6 pads it by
+  // two, and a precision of 3 keeps "caf".
+  ASSERT_EQ(utfbuf_printf(&ub, "[%6s][%-6s][%.3s][%.4s]",
+        "caf\xc3\xa9", "caf\xc3\xa9", "caf\xc3\xa9", "caf\xc3\xa9"),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(buf, "[  caf\xc3\xa9][caf\xc3\xa9  ][caf]"
+        "[caf\xc3\xa9]"), 0);
+}
+
+static void test_printf_tagged_encodings(void)
+{
+  static const uint16_t u16[] = { 0xD83E, 0xDD84, 'x', 0 };
+  static const uint32_t u32[] = { 0x266A, 0x266A, 0 };
+  static const uint8_t raw[] = { 'h', 'i', '!' };
+
+  uint16_t buf[64];
+  utfbuf_t ub;
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_16);
+
+  ASSERT_EQ(utfbuf_printf(&ub, "%hs|%3ls|%.2S|%c|\xc3\xa9",
+        u16, u32, UTF_STRARG(raw, sizeof(raw), UTF_8), 0x1F984),
+      UTF_ERROR_SUCCESS);
+
+  static const uint16_t expect[] = {
+    0xD83E, 0xDD84, 'x', '|',
+    ' ', 0x266A, 0x266A, '|',
+    'h', 'i', '|',
+    0xD83E, 0xDD84, '|',
+    0xE9, 0,
+  };
+  ASSERT_EQ(memcmp(buf, expect, sizeof(expect)), 0);
+}
+
+static void test_printf_legacy_strarg(void)
+{
+  // "日本語" in Shift_JIS, with and without a width or precision.
+  static const uint8_t sjis[] = { 0x93, 0xfa, 0x96, 0x7b, 0x8c, 0xea };
+  const utf_strarg_t arg = UTF_STRARG(sjis, sizeof(sjis), UTF_SHIFT_JIS);
+
+  char buf[64];
+  utfbuf_t ub;
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_printf(&ub, "[%S][%5S][%-4.2S]", arg, arg, arg),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(buf, "[\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e]"
+        "[  \xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e]"
+        "[\xe6\x97\xa5\xe6\x9c\xac  ]"), 0);
+
+  // A lead byte without its trail byte.
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_printf(&ub, "%5S", UTF_STRARG(sjis, 1, UTF_SHIFT_JIS)),
+      UTF_ERROR_INVALID_ARGUMENT);
+}
+
+static void test_printf_sizing(void)
+{
+  const char *fmt = "%s=%d (%8S)";
+  static const uint32_t val[] = { 0x1F984, 'z' };
+
+  // Size with a counting buffer...
+  utfbuf_t ub;
+  utfbuf_init(&ub, NULL, 0, UTF_8);
+  ASSERT_EQ(utfbuf_printf(&ub, fmt, "k\xc3\xa9y", 1234,
+        UTF_STRARG(val, sizeof(val), UTF_32)), UTF_ERROR_SUCCESS);
+
+  // "kéy=1234 (      🦄z)" plus the terminator.
+  const size_t required = utfbuf_overflow(&ub);
+  ASSERT_EQ(required, 4 + 5 + 2 + 6 + 4 + 1 + 1 + 1);
+
+  // ...then format for real into exactly that much.
+  char buf[64];
+  utfbuf_init(&ub, buf, required, UTF_8);
+  ASSERT_EQ(utfbuf_printf(&ub, fmt, "k\xc3\xa9y", 1234,
+        UTF_STRARG(val, sizeof(val), UTF_32)), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_overflow(&ub), 0);
+  ASSERT_EQ(strcmp(buf, "k\xc3\xa9y=1234 (      \xf0\x9f\xa6\x84z)"), 0);
+
+  // A short buffer holds a prefix.
+  utfbuf_init(&ub, buf, 6, UTF_8);
+  ASSERT_EQ(utfbuf_printf(&ub, fmt, "k\xc3\xa9y", 1234,
+        UTF_STRARG(val, sizeof(val), UTF_32)), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(buf, "k\xc3\xa9y="), 0);
+  ASSERT_EQ(utfbuf_truncated(&ub), 1);
+}
+
+static void test_printf_invalid(void)
+{
+  char buf[32];
+  utfbuf_t ub;
+
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_printf(&ub, "%.1s", "\xc3"),
+      UTF_ERROR_INVALID_ARGUMENT);
+
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_printf(&ub, "%q", 1), UTF_ERROR_INVALID_ARGUMENT);
+
+  // Widths and precisions past INT_MAX.
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_printf(&ub, "%99999999999s", "x"),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(utfbuf_printf(&ub, "%.99999999999d", 1),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(utfbuf_printf(&ub, "%*s", INT_MIN, "x"),
+      UTF_ERROR_INVALID_ARGUMENT);
+}
+
+RUN_TESTS(
+    test_printf_numbers,
+    test_printf_strings_count_codepoints,
+    test_printf_tagged_encodings,
+    test_printf_legacy_strarg,
+    test_printf_sizing,
+    test_printf_invalid,
+)
@@ -0,0 +1,132 @@
+#include "utf_props.h"
+#include "test.h"
+
+#include <string.h>
+
+static void test_cp_category(void)
+{
+  ASSERT_EQ(utf_cp_category('A'), UTF_GC_LU);
+  ASSERT_EQ(utf_cp_category('z'), UTF_GC_LL);
+  ASSERT_EQ(utf_cp_category('7'), UTF_GC_ND);
+  ASSERT_EQ(utf_cp_category(' '), UTF_GC_ZS);
+  ASSERT_EQ(utf_cp_category('\n'), UTF_GC_CC);
+  ASSERT_EQ(utf_cp_category(0x01C5), UTF_GC_LT);    // ǅ
+  ASSERT_EQ(utf_cp_category(0x0301), UTF_GC_MN);    // combining acute
+  ASSERT_EQ(utf_cp_category(0x20AC), UTF_GC_SC);    // €
+  ASSERT_EQ(utf_cp_category(0x2028), UTF_GC_ZL);
+  ASSERT_EQ(utf_cp_category(0x4E00), UTF_GC_LO);    // 一
+  ASSERT_EQ(utf_cp_category(0xD800), UTF_GC_CS);
+  ASSERT_EQ(utf_cp_category(0xE000), UTF_GC_CO);
+  ASSERT_EQ(utf_cp_category(0x1F600), UTF_GC_SO);   // 😀
+  ASSERT_EQ(utf_cp_category(0x0378), UTF_GC_CN);
+  ASSERT_EQ(utf_cp_category(0x110000), UTF_GC_CN);
+
+  ASSERT_EQ(!!(UTF_GC_MASK(utf_cp_category(0x00E9)) & UTF_GC_LETTER), 1);
+  ASSERT_EQ(!!(UTF_GC_MASK(utf_cp_category('(')) & UTF_GC_PUNCTUATION), 1);
+  ASSERT_EQ(!!(UTF_GC_MASK(utf_cp_category('+')) & UTF_GC_PUNCTUATION), 0);
+}
+
+static void test_cp_script(void)
+{
+  ASSERT_EQ(utf_cp_script('a'), UTF_SCRIPT_LATIN);
+  ASSERT_EQ(utf_cp_script('1'), UTF_SCRIPT_COMMON);
+  ASSERT_EQ(utf_cp_script(0x03B1), UTF_SCRIPT_GREEK);     // α
+  ASSERT_EQ(utf_cp_script(0x0416), UTF_SCRIPT_CYRILLIC);  // Ж
+  ASSERT_EQ(utf_cp_script(0x0301), UTF_SCRIPT_INHERITED);
+  ASSERT_EQ(utf_cp_script(0x3042), UTF_SCRIPT_HIRAGANA);  // あ
+  ASSERT_EQ(utf_cp_script(0x10300), UTF_SCRIPT_OLD_ITALIC);
+  ASSERT_EQ(utf_cp_script(0x0378), UTF_SCRIPT_UNKNOWN);
+  ASSERT_EQ(utf_cp_script(0x110000), UTF_SCRIPT_UNKNOWN);
+}
+
+static void test_names(void)
+{
+  ASSERT_EQ(strcmp(utf_category_name(UTF_GC_LU), "Lu"), 0);
+  ASSERT_EQ(strcmp(utf_category_name(UTF_GC_CO), "Co"), 0);
+  ASSERT_EQ(utf_category_name(UTF_GC_COUNT) == NULL, 1);
+  ASSERT_EQ(strcmp(utf_script_name(UTF_SCRIPT_OLD_ITALIC), "Old_Italic"), 0);
+  ASSERT_EQ(strcmp(utf_script_name(UTF_SCRIPT_UNKNOWN), "Unknown"), 0);
+  ASSERT_EQ(utf_script_name(UTF_SCRIPT_COUNT) == NULL, 1);
+}
+
+static void test_classify(void)
+{
+  // "Abc 1" then α, combining acute and あ.
+  const char *s = "Abc 1\xce\xb1\xcc\x81\xe3\x81\x82";
+  uint8_t out[16];
+  size_t n = 0;
+
+  ASSERT_EQ(utf_classify(s, strlen(s), UTF_8, UTF_PROP_CATEGORY,
+        out, sizeof(out), &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 8);
+  const uint8_t gc[] = { UTF_GC_LU, UTF_GC_LL, UTF_GC_LL, UTF_GC_ZS,
+    UTF_GC_ND, UTF_GC_LL, UTF_GC_MN, UTF_GC_LO };
+  ASSERT_EQ(memcmp(out, gc, sizeof(gc)), 0);
+
+  ASSERT_EQ(utf_classify(s, strlen(s), UTF_8, UTF_PROP_SCRIPT,
+        out, sizeof(out), &n), UTF_ERROR_SUCCESS);
+  const uint8_t sc[] = { UTF_SCRIPT_LATIN, UTF_SCRIPT_LATIN,
+    UTF_SCRIPT_LATIN, UTF_SCRIPT_COMMON, UTF_SCRIPT_COMMON,
+    UTF_SCRIPT_GREEK, UTF_SCRIPT_INHERITED, UTF_SCRIPT_HIRAGANA };
+  ASSERT_EQ(memcmp(out, sc, sizeof(sc)), 0);
+
+  // Measuring, then a short output: only the prefix is written.
+  ASSERT_EQ(utf_classify(s, strlen(s), UTF_8, UTF_PROP_CATEGORY,
+        NULL, 0, &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 8);
+  memset(out, 0xff, sizeof(out));
+  ASSERT_EQ(utf_classify(s, strlen(s), UTF_8, UTF_PROP_CATEGORY,
+        out, 2, &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 8);
+  ASSERT_EQ(out[1], UTF_GC_LL);
+  ASSERT_EQ(out[2], 0xff);
+
+  ASSERT_EQ(utf_classify("a\xff", 2, UTF_8, UTF_PROP_SCRIPT,
+        out, sizeof(out), &n), UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(n, 1);
+}
+
+static void test_classify_vector(void)
+{
+  // Long enough for the ASCII fast path, with a short output buffer
+  // ending mid-vector.
+  const char *s = "The quick brown fox jumps over 2 lazy dogs\xe2\x82\xac";
+  uint8_t out[64];
+  size_t n = 0;
+
+  ASSERT_EQ(utf_classify(s, strlen(s), UTF_8, UTF_PROP_CATEGORY,
+        out, sizeof(out), &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 43);
+  for (size_t i = 0; i < n; i++)
+    ASSERT_EQ(out[i], i < 42 ? utf_cp_category((uint8_t)s[i]) : UTF_GC_SC);
+
+  memset(out, 0xff, sizeof(out));
+  ASSERT_EQ(utf_classify(s, strlen(s), UTF_8, UTF_PROP_CATEGORY,
+        out, 20, &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 43);
+  ASSERT_EQ(out[19], UTF_GC_ZS);
+  ASSERT_EQ(out[20], 0xff);
+
+  const uint16_t s16[] = { 'x', 0x0416, 0xD83D, 0xDE00 };
+  ASSERT_EQ(utf_classify(s16, sizeof(s16), UTF_16, UTF_PROP_SCRIPT,
+        out, sizeof(out), &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 3);
+  ASSERT_EQ(out[0], UTF_SCRIPT_LATIN);
+  ASSERT_EQ(out[1], UTF_SCRIPT_CYRILLIC);
+  ASSERT_EQ(out[2], UTF_SCRIPT_COMMON);
+
+  const uint32_t s32[] = { 0x3042, 'Q' };
+  ASSERT_EQ(utf_classify(s32, sizeof(s32), UTF_32, UTF_PROP_CATEGORY,
+        out, sizeof(out), &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 2);
+  ASSERT_EQ(out[0], UTF_GC_LO);
+  ASSERT_EQ(out[1], UTF_GC_LU);
+}
+
+RUN_TESTS(
+    test_cp_category,
+    test_cp_script,
+    test_names,
+    test_classify,
+    test_classify_vector,
+)
@@ -0,0 +1,185 @@
+#include "utf_rope.h"
+#include "test.h"
+#include "macros.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+typedef struct {
+  size_t live;
+  size_t allocs;
+} alloc_stats_t;
+
+static void *counting_realloc(void *ctx, void *ptr, size_t size)
+{
+  alloc_stats_t *stats = ctx;
+
+  if (!size) {
+    stats->live--;
+    free(ptr);
+    return NULL;
+  }
+
+  if (!ptr) {
+    stats->live++;
+    stats->allocs++;
+  }
+
+  return realloc(ptr, size);
+}
+
+static void test_rope_append_mixed(void)
+{
+  alloc_stats_t stats = { 0 };
+  const utf_alloc_t alloc = { counting_realloc, &stats };
+
+  utf_rope_t rope;
+  ASSERT_EQ(utf_rope_init(&rope, UTF_8, &alloc), UTF_ERROR_SUCCESS);
+
+  static const uint16_t u16[] = { 0xE9, 0xD83E, 0xDD84 };
+  static const uint32_t u32[] = { 0x266A };
+
+  ASSERT_EQ(utf_rope_append(&rope, "ab", 2, UTF_8), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_rope_append(&rope, u16, sizeof(u16), UTF_16),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_rope_append(&rope, u32, sizeof(u32), UTF_32),
+      UTF_ERROR_SUCCESS);
+
+  // Small appends all land in one chunk, as one piece.
+  ASSERT_EQ(rope.n_pieces, 1);
+  ASSERT_EQ(utf_rope_codepoints(&rope), 5);
+  ASSERT_EQ(utf_rope_length(&rope), 2 + 2 + 4 + 3);
+
+  uint16_t out[16];
+  utfbuf_t ub;
+  utfbuf_init(&ub, out, sizeof(out), UTF_16);
+  ASSERT_EQ(utf_rope_flatten(&rope, &ub), UTF_ERROR_SUCCESS);
+
+  static const uint16_t expect[] = {
+    'a', 'b', 0xE9, 0xD83E, 0xDD84, 0x266A, 0,
+  };
+  ASSERT_EQ(memcmp(out, expect, sizeof(expect)), 0);
+
+  // Malformed input keeps the valid prefix.
+  ASSERT_EQ(utf_rope_append(&rope, "c\xc3", 2, UTF_8),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(utf_rope_codepoints(&rope), 6);
+
+  utf_rope_free(&rope);
+  ASSERT_EQ(stats.live, 0);
+}
+
+static void test_rope_spans_chunks(void)
+{
+  alloc_stats_t stats = { 0 };
+  const utf_alloc_t alloc = { counting_realloc, &stats };
+
+  utf_rope_t rope;
+  utf_rope_init(&rope, UTF_32, &alloc);
+
+  // 3000 codepoints of UTF-32 need three 4 KiB chunks.
+  static char text[3000];
+  for (size_t i = 0; i < sizeof(text); i++)
+    text[i] = 'a' + (i % 26);
+
+  ASSERT_EQ(utf_rope_append(&rope, text, sizeof(text), UTF_8),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(rope.n_pieces, 3);
+  ASSERT_EQ(utf_rope_codepoints(&rope), 3000);
+
+  // Size via a counting buffer, then flatten for real.
+  utfbuf_t ub;
+  utfbuf_init(&ub, NULL, 0, UTF_8);
+  ASSERT_EQ(utf_rope_flatten(&rope, &ub), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utfbuf_overflow(&ub), 3001);
+
+  static char flat[3001];
+  utfbuf_init(&ub, flat, sizeof(flat), UTF_8);
+  ASSERT_EQ(utf_rope_flatten(&rope, &ub), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(memcmp(flat, text, sizeof(text)), 0);
+  ASSERT_EQ(flat[3000], 0);
+
+  utf_rope_free(&rope);
+  ASSERT_EQ(stats.live, 0);
+}
+
+static void test_rope_concat_and_slice(void)
+{
+  alloc_stats_t stats = { 0 };
+  const utf_alloc_t alloc = { counting_realloc, &stats };
+
+  utf_rope_t a, b, s;
+  utf_rope_init(&a, UTF_8, &alloc);
+  utf_rope_init(&b, UTF_8, &alloc);
+  utf_rope_init(&s, UTF_8, &alloc);
+
+  const char *hello = "h\xc3\xa9llo ";
+  const char *world = "w\xc3\xb6rld";
+  utf_rope_append(&a, hello, strlen(hello), UTF_8);
+  utf_rope_append(&b, world, strlen(world), UTF_8);
+
+  const size_t chunks = stats.allocs;
+  ASSERT_EQ(utf_rope_concat(&a, &b), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_rope_codepoints(&a), 11);
+  ASSERT_EQ(a.n_pieces, 2);
+  ASSERT_EQ(a.pieces[1].chunk == b.pieces[0].chunk, 1);
+
+  // "llo wö": crosses from the first piece into the second.
+  ASSERT_EQ(utf_rope_slice(&s, &a, 2, 6), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_rope_codepoints(&s), 6);
+
+  // No chunks were allocated: only the slice's piece array.
+  ASSERT_EQ(stats.allocs - chunks, 1);
+
+  char out[32];
+  utfbuf_t ub;
+  utfbuf_init(&ub, out, sizeof(out), UTF_8);
+  ASSERT_EQ(utf_rope_flatten(&s, &ub), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(strcmp(out, "llo w\xc3\xb6"), 0);
+
+  // Appending to a rope whose tail chunk is shared must not clobber
+  // the other rope.
+  ASSERT_EQ(utf_rope_append(&s, "!", 1, UTF_8), UTF_ERROR_SUCCESS);
+  utfbuf_init(&ub, out, sizeof(out), UTF_8);
+  utf_rope_flatten(&a, &ub);
+  ASSERT_EQ(strcmp(out, "h\xc3\xa9llo w\xc3\xb6rld"), 0);
+
+  // Slicing into a rope of another encoding transcodes.
+  utf_rope_t s32;
+  utf_rope_init(&s32, UTF_32, &alloc);
+  ASSERT_EQ(utf_rope_slice(&s32, &a, 1, 100), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_rope_codepoints(&s32), 10);
+  ASSERT_EQ(utf_rope_length(&s32), 40);
+
+  utf_rope_free(&a);
+  utf_rope_free(&b);
+  utf_rope_free(&s);
+  utf_rope_free(&s32);
+  ASSERT_EQ(stats.live, 0);
+}
+
+static void test_rope_self_concat(void)
+{
+  utf_rope_t rope;
+  utf_rope_init(&rope, UTF_16, NULL);
+
+  utf_rope_append(&rope, "ab", 2, UTF_8);
+  ASSERT_EQ(utf_rope_concat(&rope, &rope), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_rope_concat(&rope, &rope), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_rope_codepoints(&rope), 8);
+
+  char out[16];
+  utfbuf_t ub;
+  utfbuf_init(&ub, out, sizeof(out), UTF_8);
+  utf_rope_flatten(&rope, &ub);
+  ASSERT_EQ(strcmp(out, "abababab"), 0);
+
+  utf_rope_free(&rope);
+}
+
+RUN_TESTS(
+    test_rope_append_mixed,
+    test_rope_spans_chunks,
+    test_rope_concat_and_slice,
+    test_rope_self_concat,
+)
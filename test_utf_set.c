@@ -0,0 +1,178 @@
+#include "utf_set.h"
+#include "utf_simd.h"
+#include "test.h"
+
+#include <string.h>
+
+static void test_ranges(void)
+{
+  utf_set_t set;
+  utf_set_init(&set, NULL);
+
+  ASSERT_EQ(utf_set_add_range(&set, 0x400, 0x4FF), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_set_add_range(&set, 0x100, 0x17F), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_set_add_range(&set, 0x3000, 0x3000), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(set.n_ranges, 3);
+
+  // Touching and overlapping ranges merge.
+  ASSERT_EQ(utf_set_add_range(&set, 0x180, 0x1FF), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(set.n_ranges, 3);
+  ASSERT_EQ(utf_set_add_range(&set, 0x150, 0x3001), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(set.n_ranges, 1);
+  ASSERT_EQ(set.ranges[0].first, 0x100);
+  ASSERT_EQ(set.ranges[0].last, 0x3001);
+
+  // Ranges spanning ASCII go partly to the bitmap.
+  ASSERT_EQ(utf_set_add_range(&set, 'x', 0x85), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_set_add_range(&set, 0x10FFF0, 0xFFFFFFFF),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_set_add_range(&set, 5, 4), UTF_ERROR_INVALID_ARGUMENT);
+
+  ASSERT_EQ(utf_set_contains(&set, 'w'), 0);
+  ASSERT_EQ(utf_set_contains(&set, 'x'), 1);
+  ASSERT_EQ(utf_set_contains(&set, 0x7F), 1);
+  ASSERT_EQ(utf_set_contains(&set, 0x85), 1);
+  ASSERT_EQ(utf_set_contains(&set, 0x86), 0);
+  ASSERT_EQ(utf_set_contains(&set, 0x2000), 1);
+  ASSERT_EQ(utf_set_contains(&set, 0x3002), 0);
+  ASSERT_EQ(utf_set_contains(&set, 0x10FFFF), 1);
+  ASSERT_EQ(utf_set_contains(&set, 0x110000), 0);
+
+  utf_set_free(&set);
+  ASSERT_EQ(set.n_ranges, 0);
+  ASSERT_EQ(utf_set_contains(&set, 'x'), 0);
+}
+
+static void test_properties(void)
+{
+  utf_set_t ident;
+  utf_set_init(&ident, NULL);
+  ASSERT_EQ(utf_set_add_categories(&ident, UTF_GC_LETTER | UTF_GC_NUMBER),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_set_add_chars(&ident, "_", 1, UTF_8), UTF_ERROR_SUCCESS);
+
+  ASSERT_EQ(utf_set_contains(&ident, 'a'), 1);
+  ASSERT_EQ(utf_set_contains(&ident, '_'), 1);
+  ASSERT_EQ(utf_set_contains(&ident, '9'), 1);
+  ASSERT_EQ(utf_set_contains(&ident, '-'), 0);
+  ASSERT_EQ(utf_set_contains(&ident, 0x00E9), 1);
+  ASSERT_EQ(utf_set_contains(&ident, 0x4E00), 1);
+  ASSERT_EQ(utf_set_contains(&ident, 0x3000), 0);
+
+  const char *s = "na\xc3\xafve_id2 = 1";
+  size_t n;
+  ASSERT_EQ(utf_span(s, strlen(s), UTF_8, &ident, &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 10);
+  utf_set_free(&ident);
+
+  utf_set_t greek;
+  utf_set_init(&greek, NULL);
+  ASSERT_EQ(utf_set_add_script(&greek, UTF_SCRIPT_GREEK),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_set_contains(&greek, 0x03B1), 1);
+  ASSERT_EQ(utf_set_contains(&greek, 'a'), 0);
+  utf_set_free(&greek);
+}
+
+static void test_span_utf8(void)
+{
+  utf_set_t ws;
+  utf_set_init(&ws, NULL);
+  // Space, tab, newlines and U+3000 IDEOGRAPHIC SPACE.
+  ASSERT_EQ(utf_set_add_chars(&ws, " \t\r\n\xe3\x80\x80", 7, UTF_8),
+      UTF_ERROR_SUCCESS);
+
+  const char *s = "  \t\xe3\x80\x80 \n  word and more words after it";
+  size_t n;
+  ASSERT_EQ(utf_span(s, strlen(s), UTF_8, &ws, &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 10);
+  ASSERT_EQ(utf_cspan(s + n, strlen(s + n), UTF_8, &ws, &n),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 4);
+
+  // Long runs go through the vector path.
+  const char *word = "abcdefghijklmnopqrstuvwxyz0123456789\xc3\xa9\xe3\x80\x80x";
+  ASSERT_EQ(utf_find_in_set(word, strlen(word), UTF_8, &ws, &n),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 38);
+  ASSERT_EQ(utf_find_in_set(word, 38, UTF_8, &ws, &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n == UTF_NPOS, 1);
+
+  const char *spaces = "                                  x";
+  ASSERT_EQ(utf_span(spaces, strlen(spaces), UTF_8, &ws, &n),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 34);
+  ASSERT_EQ(utf_span(spaces, 34, UTF_8, &ws, &n), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 34);
+
+  ASSERT_EQ(utf_cspan("ab\xff ", 4, UTF_8, &ws, &n),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(n, 2);
+
+  utf_set_free(&ws);
+}
+
+static void test_span_wide(void)
+{
+  utf_set_t set;
+  utf_set_init(&set, NULL);
+  // NUL and a few letters; units of 0x8000 and above must never look
+  // like NUL once narrowed.
+  utf_set_add_chars(&set, "\0abc", 4, UTF_8);
+
+  uint16_t s16[40];
+  for (size_t i = 0; i < 40; i++)
+    s16[i] = "abc"[i % 3];
+  s16[20] = 0xD83D;
+  s16[21] = 0xDE00;
+  size_t n;
+  ASSERT_EQ(utf_span(s16, sizeof(s16), UTF_16, &set, &n),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 40);
+  ASSERT_EQ(utf_cspan(s16, sizeof(s16), UTF_16, &set, &n),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 0);
+  s16[3] = 0x8000;
+  ASSERT_EQ(utf_span(s16, sizeof(s16), UTF_16, &set, &n),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 6);
+
+  uint32_t s32[40];
+  for (size_t i = 0; i < 40; i++)
+    s32[i] = 0x10000 + i;
+  s32[33] = 0;
+  ASSERT_EQ(utf_find_in_set(s32, sizeof(s32), UTF_32, &set, &n),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(n, 33 * 4);
+  s32[17] = 0x110000;
+  ASSERT_EQ(utf_find_in_set(s32, sizeof(s32), UTF_32, &set, &n),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(n, 17 * 4);
+
+  utf_set_free(&set);
+}
+
+static void test_simd_set_mask(void)
+{
+  // The shuffle form of the ASCII lookup agrees with the scalar one for
+  // every byte value in every lane.
+  uint8_t table[16];
+  for (int l = 0; l < 16; l++)
+    table[l] = (uint8_t)(0x5a ^ (l * 37));
+
+  for (int b = 0; b < 256; b++) {
+    uint8_t p[UTF_SIMD_WIDTH];
+    for (int i = 0; i < UTF_SIMD_WIDTH; i++)
+      p[i] = (uint8_t)(b + i * 17);
+    ASSERT_EQ(utf_simd_set_mask(p, table),
+        utf_simd_set_mask_scalar(p, table));
+  }
+}
+
+RUN_TESTS(
+    test_ranges,
+    test_properties,
+    test_span_utf8,
+    test_span_wide,
+    test_simd_set_mask,
+)
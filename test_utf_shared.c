@@ -0,0 +1,182 @@
+#include "utf_shared.h"
+#include "utf_printf.h"
+#include "test.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+static _Alignas(8) uint8_t mem[4096];
+
+static void test_append_and_read(void)
+{
+  utf_sharedbuf_t sb;
+  ASSERT_EQ(utf_sharedbuf_init(&sb, mem, sizeof(mem), UTF_8),
+      UTF_ERROR_SUCCESS);
+
+  ASSERT_EQ(utf_sharedbuf_append(&sb, "first", 5, UTF_8),
+      UTF_ERROR_SUCCESS);
+  const uint16_t s16[] = { 'c', 0xE9, 0xD83D, 0xDE00 };
+  ASSERT_EQ(utf_sharedbuf_append(&sb, s16, sizeof(s16), UTF_16),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_sharedbuf_append(&sb, "", 0, UTF_8), UTF_ERROR_SUCCESS);
+
+  size_t cursor = 0;
+  const void *rec;
+  size_t len;
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), true);
+  ASSERT_EQ(len, 5);
+  ASSERT_EQ(strcmp(rec, "first"), 0);
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), true);
+  ASSERT_EQ(len, 7);
+  ASSERT_EQ(strcmp(rec, "c\xc3\xa9\xf0\x9f\x98\x80"), 0);
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), true);
+  ASSERT_EQ(len, 0);
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), false);
+  ASSERT_EQ(utf_sharedbuf_overflow(&sb), 0);
+
+  ASSERT_EQ(utf_sharedbuf_append(&sb, "a\xff", 2, UTF_8),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), false);
+}
+
+static void test_commit_order(void)
+{
+  utf_sharedbuf_t sb;
+  utf_sharedbuf_init(&sb, mem, sizeof(mem), UTF_32);
+
+  utf_shared_record_t first, second;
+  ASSERT_EQ(utf_sharedbuf_reserve(&sb, 8, &first), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_sharedbuf_reserve(&sb, 8, &second), UTF_ERROR_SUCCESS);
+  utfbuf_write_utf32(&second.ub, 'B');
+  utf_sharedbuf_commit(&sb, &second);
+
+  // The second record is complete, but the first is still in progress.
+  size_t cursor = 0;
+  const void *rec;
+  size_t len;
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), false);
+  ASSERT_EQ(cursor, 0);
+
+  utfbuf_write_utf32(&first.ub, 'A');
+  utf_sharedbuf_commit(&sb, &first);
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), true);
+  ASSERT_EQ(len, 4);
+  ASSERT_EQ(*(const uint32_t *)rec, 'A');
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), true);
+  ASSERT_EQ(*(const uint32_t *)rec, 'B');
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), false);
+}
+
+static void test_overflow(void)
+{
+  utf_sharedbuf_t sb;
+  utf_sharedbuf_init(&sb, mem, 64, UTF_8);
+
+  // 8 byte header + 17 bytes, padded to 32: two fit.
+  const char *text = "sixteen bytes...";
+  ASSERT_EQ(utf_sharedbuf_append(&sb, text, 16, UTF_8), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_sharedbuf_append(&sb, text, 16, UTF_8), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_sharedbuf_append(&sb, "x", 1, UTF_8), UTF_ERROR_FAILURE);
+  ASSERT_EQ(utf_sharedbuf_overflow(&sb), 2);
+
+  // A reservation straddling the end fails too.
+  utf_sharedbuf_init(&sb, mem, 64, UTF_8);
+  ASSERT_EQ(utf_sharedbuf_append(&sb, text, 16, UTF_8), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(utf_sharedbuf_append(&sb, "a longer record, over 32", 24, UTF_8),
+      UTF_ERROR_FAILURE);
+  ASSERT_EQ(utf_sharedbuf_append(&sb, "x", 1, UTF_8), UTF_ERROR_FAILURE);
+  ASSERT_EQ(utf_sharedbuf_overflow(&sb), 27);
+
+  size_t cursor = 0;
+  const void *rec;
+  size_t len;
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), true);
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), false);
+
+  // Writing past a reservation keeps a prefix and counts overflow.
+  utf_sharedbuf_init(&sb, mem, sizeof(mem), UTF_8);
+  utf_shared_record_t r;
+  ASSERT_EQ(utf_sharedbuf_reserve(&sb, 4, &r), UTF_ERROR_SUCCESS);
+  utfbuf_write_utf8_string(&r.ub, "abcdef");
+  utf_sharedbuf_commit(&sb, &r);
+  ASSERT_EQ(utf_sharedbuf_overflow(&sb) > 0, 1);
+  cursor = 0;
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), true);
+  ASSERT_EQ(strcmp(rec, "abc"), 0);
+
+  // Failed reservations may be committed harmlessly.
+  ASSERT_EQ(utf_sharedbuf_reserve(&sb, 0, &r), UTF_ERROR_INVALID_ARGUMENT);
+  utf_sharedbuf_commit(&sb, &r);
+  ASSERT_EQ(utf_sharedbuf_next(&sb, &cursor, &rec, &len), false);
+}
+
+#define N_THREADS 4
+#define N_RECORDS 500
+
+static _Alignas(8) uint8_t shared_mem[N_THREADS * N_RECORDS * 32];
+
+static void *producer(void *arg)
+{
+  utf_sharedbuf_t *sb = arg;
+  static _Atomic int next_id;
+  const int id = atomic_fetch_add(&next_id, 1);
+
+  for (int i = 0; i < N_RECORDS; i++) {
+    // Formatted in two passes: measure, then write in place.
+    utfbuf_t counter;
+    utfbuf_init(&counter, NULL, 0, UTF_16);
+    utfbuf_printf(&counter, "t%d:%d", id, i);
+
+    utf_shared_record_t rec;
+    if (utf_sharedbuf_reserve(sb, utfbuf_overflow(&counter), &rec))
+      return NULL;
+    utfbuf_printf(&rec.ub, "t%d:%d", id, i);
+    utf_sharedbuf_commit(sb, &rec);
+  }
+  return NULL;
+}
+
+static void test_concurrent_producers(void)
+{
+  utf_sharedbuf_t sb;
+  utf_sharedbuf_init(&sb, shared_mem, sizeof(shared_mem), UTF_16);
+
+  pthread_t threads[N_THREADS];
+  for (int i = 0; i < N_THREADS; i++)
+    pthread_create(&threads[i], NULL, producer, &sb);
+
+  // Read while the producers run. Every record seen is complete, and
+  // each thread's appear in order.
+  int seen[N_THREADS] = { 0 };
+  size_t cursor = 0, n = 0;
+  while (n < N_THREADS * N_RECORDS) {
+    const void *rec;
+    size_t len;
+    if (!utf_sharedbuf_next(&sb, &cursor, &rec, &len))
+      continue;
+
+    char text[32];
+    size_t i;
+    for (i = 0; i < len / 2 && i < sizeof(text) - 1; i++)
+      text[i] = (char)((const uint16_t *)rec)[i];
+    text[i] = '\0';
+
+    int id, seq;
+    ASSERT_EQ(sscanf(text, "t%d:%d", &id, &seq), 2);
+    ASSERT_EQ(seq, seen[id]);
+    seen[id]++;
+    n++;
+  }
+
+  for (int i = 0; i < N_THREADS; i++)
+    pthread_join(threads[i], NULL);
+  ASSERT_EQ(utf_sharedbuf_overflow(&sb), 0);
+}
+
+RUN_TESTS(
+    test_append_and_read,
+    test_commit_order,
+    test_overflow,
+    test_concurrent_producers,
+)
@@ -0,0 +1,256 @@
+#include "utf_str.h"
+#include "test.h"
+#include "macros.h"
+
+#include <string.h>
+
+static void test_count_codepoints(void)
+{
+  const char *s = "a\xc3\xa9\xe2\x99\xaa\xf0\x9f\xa6\x84"
+    "0123456789abcdef";
+  ASSERT_EQ(utf_count_codepoints(s, strlen(s), UTF_8), 4 + 16);
+
+  static const uint16_t u16[] = { 'a', 0xD83E, 0xDD84, 'b' };
+  ASSERT_EQ(utf_count_codepoints(u16, sizeof(u16), UTF_16), 3);
+
+  static const uint32_t u32[] = { 'a', 0x1F984 };
+  ASSERT_EQ(utf_count_codepoints(u32, sizeof(u32), UTF_32), 2);
+}
+
+static void test_find_ascii(void)
+{
+  const char *hay = "the quick brown fox jumps over the lazy dog";
+  size_t off;
+
+  ASSERT_EQ(utf_find(hay, strlen(hay), UTF_8, "lazy", 4, UTF_8,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 35);
+
+  ASSERT_EQ(utf_find(hay, strlen(hay), UTF_8, "the", 3, UTF_8,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 0);
+
+  ASSERT_EQ(utf_find(hay, strlen(hay), UTF_8, "cat", 3, UTF_8,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off == UTF_NPOS, 1);
+
+  ASSERT_EQ(utf_find(hay, strlen(hay), UTF_8, "", 0, UTF_8,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 0);
+
+  // Needle longer than the haystack.
+  ASSERT_EQ(utf_find("ab", 2, UTF_8, "abc", 3, UTF_8,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off == UTF_NPOS, 1);
+}
+
+static void test_find_cross_encoding(void)
+{
+  // "xx…é♪🦄yy" with the needle "♪🦄" supplied as UTF-16 and UTF-32.
+  char hay[128];
+  memset(hay, 'x', 40);
+  memcpy(hay + 40, "\xc3\xa9\xe2\x99\xaa\xf0\x9f\xa6\x84yy", 11);
+  const size_t hlen = 51;
+
+  static const uint16_t n16[] = { 0x266A, 0xD83E, 0xDD84 };
+  static const uint32_t n32[] = { 0x266A, 0x1F984 };
+  size_t off;
+
+  ASSERT_EQ(utf_find(hay, hlen, UTF_8, n16, sizeof(n16), UTF_16,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 42);
+
+  ASSERT_EQ(utf_find(hay, hlen, UTF_8, n32, sizeof(n32), UTF_32,
+        UTF_UNIT_CODEPOINTS, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 41);
+
+  // And the other way round: UTF-8 needle, UTF-16 haystack.
+  static const uint16_t hay16[] = {
+    'a', 'b', 0xD83E, 0xDD84, 'c', 0xE9, 'd',
+  };
+  ASSERT_EQ(utf_find(hay16, sizeof(hay16), UTF_16, "\xc3\xa9", 2,
+        UTF_8, UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 10);
+
+  ASSERT_EQ(utf_find(hay16, sizeof(hay16), UTF_16, "\xc3\xa9", 2,
+        UTF_8, UTF_UNIT_CODEPOINTS, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 4);
+
+  // Truncated needles: in the same encoding the match is rejected
+  // at the boundary check, otherwise the transcode fails.
+  ASSERT_EQ(utf_find(hay, hlen, UTF_8, "\xc3", 1, UTF_8,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off == UTF_NPOS, 1);
+  ASSERT_EQ(utf_find(hay16, sizeof(hay16), UTF_16, "\xc3", 1, UTF_8,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_INVALID_ARGUMENT);
+}
+
+static void test_find_boundaries(void)
+{
+  size_t off;
+
+  // U+0141 U+4100 is 41 01 00 41 in UTF-16LE; the bytes of U+0100
+  // (00 01) appear at byte offset 1, which is not a code unit
+  // boundary, and must not match.
+  static const uint16_t hay16[] = { 0x0141, 0x4100, 0x0100 };
+  static const uint16_t nd16[] = { 0x0100 };
+  ASSERT_EQ(utf_find(hay16, sizeof(hay16), UTF_16, nd16, sizeof(nd16),
+        UTF_16, UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 4);
+
+  // A supplementary needle matches the complete surrogate pair, not
+  // the unpaired high surrogate at the end of the haystack.
+  static const uint16_t pair[] = { 0xD83E, 0xDD84, 0xD83E };
+  static const uint32_t hi[] = { 0x1F984 };
+  ASSERT_EQ(utf_find(pair, sizeof(pair), UTF_16, hi, sizeof(hi),
+        UTF_32, UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 0);
+
+  // In (invalid) UTF-8 the match "\xc3\xa9" followed by a stray
+  // continuation byte is not on a boundary at its end.
+  const char *hay8 = "\xc3\xa9\x80 \xc3\xa9";
+  ASSERT_EQ(utf_find(hay8, 6, UTF_8, "\xc3\xa9", 2, UTF_8,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 4);
+}
+
+static void test_find_long_needle(void)
+{
+  // A needle too large for the on-stack transcoding buffer.
+  static uint32_t nd[200];
+  static char hay[1024];
+
+  for (size_t i = 0; i < ARRAY_LENGTH(nd); i++)
+    nd[i] = 'a' + (i % 26);
+
+  memset(hay, '-', sizeof(hay));
+  for (size_t i = 0; i < ARRAY_LENGTH(nd); i++)
+    hay[700 + i] = 'a' + (i % 26);
+
+  size_t off;
+  ASSERT_EQ(utf_find(hay, sizeof(hay), UTF_8, nd, sizeof(nd), UTF_32,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(off, 700);
+
+  // A malformed needle is rejected whatever its length: here a lone
+  // low surrogate after enough text to need the heap.
+  static uint16_t bad[201];
+  for (size_t i = 0; i < 200; i++)
+    bad[i] = 0xE9;
+  bad[200] = 0xDC00;
+  ASSERT_EQ(utf_find(hay, sizeof(hay), UTF_8, bad, sizeof(bad), UTF_16,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_INVALID_ARGUMENT);
+
+  // Likewise a needle ending mid-codepoint.
+  bad[200] = 0xD83E;
+  ASSERT_EQ(utf_find(hay, sizeof(hay), UTF_8, bad, sizeof(bad), UTF_16,
+        UTF_UNIT_BYTES, &off), UTF_ERROR_INVALID_ARGUMENT);
+}
+
+static int sign(int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+static int compare_helper(const void *a, size_t alen, utf_enc_t aenc,
+    const void *b, size_t blen, utf_enc_t benc)
+{
+  int order = 42;
+  if (utf_compare(a, alen, aenc, b, blen, benc, &order))
+    return 42;
+  return sign(order);
+}
+
+static void test_compare_same_encoding(void)
+{
+  ASSERT_EQ(compare_helper("abc", 3, UTF_8, "abd", 3, UTF_8), -1);
+  ASSERT_EQ(compare_helper("abc", 3, UTF_8, "ab", 2, UTF_8), 1);
+  ASSERT_EQ(compare_helper("abc", 3, UTF_8, "abc", 3, UTF_8), 0);
+
+  // U+1F984 sorts after U+FFFD even though its leading UTF-16 code
+  // unit (a surrogate) is smaller.
+  static const uint16_t unicorn[] = { 0xD83E, 0xDD84 };
+  static const uint16_t fffd[] = { 0xFFFD };
+  ASSERT_EQ(compare_helper(unicorn, sizeof(unicorn), UTF_16,
+        fffd, sizeof(fffd), UTF_16), 1);
+
+  static const uint32_t lhs[] = { 0x100, 'a' };
+  static const uint32_t rhs[] = { 0x1F984 };
+  ASSERT_EQ(compare_helper(lhs, sizeof(lhs), UTF_32,
+        rhs, sizeof(rhs), UTF_32), -1);
+}
+
+static void test_compare_mixed(void)
+{
+  // A long shared ASCII prefix exercises the vector lockstep.
+  const char *a8 = "the quick brown fox jumps over the lazy dog \xc3\xa9";
+  const size_t a8_len = strlen(a8);
+
+  uint16_t a16[64];
+  size_t n16 = 0;
+  for (const char *p = "the quick brown fox jumps over the lazy dog "; *p;
+      p++)
+    a16[n16++] = *p;
+  a16[n16++] = 0xE9;
+
+  ASSERT_EQ(compare_helper(a8, a8_len, UTF_8,
+        a16, n16 * 2, UTF_16), 0);
+  ASSERT_EQ(utf_equal(a8, a8_len, UTF_8, a16, n16 * 2, UTF_16), 1);
+  ASSERT_EQ(utf_equal(a16, n16 * 2, UTF_16, a8, a8_len, UTF_8), 1);
+
+  // Prefix relation.
+  ASSERT_EQ(compare_helper(a8, a8_len - 2, UTF_8,
+        a16, n16 * 2, UTF_16), -1);
+  ASSERT_EQ(compare_helper(a16, n16 * 2, UTF_16,
+        a8, a8_len - 2, UTF_8), 1);
+
+  // Divergence inside the vector-width prefix.
+  a16[4] = 'Q';
+  ASSERT_EQ(compare_helper(a8, a8_len, UTF_8,
+        a16, n16 * 2, UTF_16), 1);
+  ASSERT_EQ(utf_equal(a8, a8_len, UTF_8, a16, n16 * 2, UTF_16), 0);
+  a16[4] = 'q';
+
+  // Divergence on a non-ASCII codepoint.
+  a16[n16-1] = 0xEA;
+  ASSERT_EQ(compare_helper(a8, a8_len, UTF_8,
+        a16, n16 * 2, UTF_16), -1);
+
+  // A NUL byte against a code unit of 0x8000 or more, in the vector
+  // lockstep.
+  char nul8[17] = { 0 };
+  uint16_t nul16[17] = { 0 };
+  nul16[3] = 0xD7FF;
+  ASSERT_EQ(compare_helper(nul8, sizeof(nul8), UTF_8,
+        nul16, sizeof(nul16), UTF_16), -1);
+
+  // Supplementary codepoints across all three encodings.
+  static const uint32_t u32[] = { 'x', 0x1F984 };
+  static const uint16_t u16[] = { 'x', 0xD83E, 0xDD84 };
+  const char *u8 = "x\xf0\x9f\xa6\x84";
+  ASSERT_EQ(utf_equal(u32, sizeof(u32), UTF_32, u16, sizeof(u16),
+        UTF_16), 1);
+  ASSERT_EQ(utf_equal(u8, 5, UTF_8, u32, sizeof(u32), UTF_32), 1);
+  ASSERT_EQ(compare_helper(u8, 5, UTF_8, u16, 2, UTF_16), 1);
+
+  // Malformed input.
+  ASSERT_EQ(compare_helper("\xc3", 1, UTF_8, u16, sizeof(u16),
+        UTF_16), 42);
+  ASSERT_EQ(compare_helper("x\xc3", 2, UTF_8, u16, sizeof(u16),
+        UTF_16), 42);
+  ASSERT_EQ(utf_equal("x\xc3", 2, UTF_8, u16, sizeof(u16), UTF_16), 0);
+
+  // In the same encoding malformed text is only compared bytewise.
+  ASSERT_EQ(utf_equal("\xff", 1, UTF_8, "\xff", 1, UTF_8), 1);
+  ASSERT_EQ(utf_equal("\xff", 1, UTF_8, "\xfe", 1, UTF_8), 0);
+}
+
+RUN_TESTS(
+    test_count_codepoints,
+    test_find_ascii,
+    test_find_cross_encoding,
+    test_find_boundaries,
+    test_find_long_needle,
+    test_compare_same_encoding,
+    test_compare_mixed,
+)
@@ -0,0 +1,125 @@
+#include "utf_translit.h"
+#include "utf_buffer.h"
+#include "test.h"
+
+#include <string.h>
+
+static int spells(uint32_t cp, const char *expect)
+{
+  const char *ascii;
+  size_t n;
+  if (!utf_cp_translit(cp, &ascii, &n))
+    return 0;
+  return n == strlen(expect) && !memcmp(ascii, expect, n);
+}
+
+static void test_cp_translit(void)
+{
+  ASSERT_EQ(spells('a', "a"), 1);
+  ASSERT_EQ(spells(0x00E9, "e"), 1);     // é
+  ASSERT_EQ(spells(0x00DF, "ss"), 1);    // ß
+  ASSERT_EQ(spells(0x00C6, "AE"), 1);    // Æ
+  ASSERT_EQ(spells(0x0142, "l"), 1);     // ł
+  ASSERT_EQ(spells(0xFB01, "fi"), 1);    // ﬁ
+  ASSERT_EQ(spells(0x01C5, "Dz"), 1);    // ǅ, via U+017E ž
+  ASSERT_EQ(spells(0x212B, "A"), 1);     // ANGSTROM SIGN
+  ASSERT_EQ(spells(0x1EA0, "A"), 1);     // Ạ
+  ASSERT_EQ(spells(0x2460, "1"), 1);     // ①
+  ASSERT_EQ(spells(0x00BD, "1/2"), 1);   // ½
+  ASSERT_EQ(spells(0xFF21, "A"), 1);     // FULLWIDTH A
+  ASSERT_EQ(spells(0x2026, "..."), 1);   // …
+  ASSERT_EQ(spells(0x201C, "\""), 1);    // “
+  ASSERT_EQ(spells(0x0301, ""), 1);      // COMBINING ACUTE ACCENT
+
+  // No ASCII spelling.
+  ASSERT_EQ(spells(0x4E00, ""), 0);
+  ASSERT_EQ(spells(0x0416, ""), 0);      // Ж
+  ASSERT_EQ(spells(0x00A8, ""), 0);      // ¨
+  ASSERT_EQ(spells(0x0E48, ""), 0);      // Thai tone mark
+}
+
+static void test_write_translit(void)
+{
+  UTFBUF_DEFINE_LOCAL(ub, 64, UTF_8);
+  utfbuf_set_translit(&ub, true);
+
+  ASSERT_EQ(utfbuf_write_utf8_string(&ub,
+        "\xc3\x86r\xc3\xb8sk\xc3\xb8" "bing"), 0);
+  ASSERT_EQ(strcmp((const char *)ub_storage, "AEroskobing"), 0);
+
+  // Decomposed input loses its diacritics; CJK passes through.
+  const char *mixed = " Cafe\xcc\x81 \xe6\x97\xa5\xe6\x9c\xac";
+  ASSERT_EQ(utfbuf_write(&ub, mixed, strlen(mixed), UTF_8), 0);
+  ASSERT_EQ(strcmp((const char *)ub_storage,
+        "AEroskobing Cafe \xe6\x97\xa5\xe6\x9c\xac"), 0);
+
+  // Off again.
+  utfbuf_set_translit(&ub, false);
+  ASSERT_EQ(utfbuf_write_utf8_string(&ub, "\xc3\xa9"), 0);
+  ASSERT_EQ(utfbuf_length(&ub), 25);
+}
+
+static void test_write_translit_wide(void)
+{
+  // ASCII runs longer than a vector around "Straße", from UTF-16 and
+  // UTF-32 into UTF-16.
+  const char *text = "The quick brown fox: Stra\xc3\x9f" "e -- "
+    "jumps over the lazy dog";
+  const char *expect = "The quick brown fox: Strasse -- "
+    "jumps over the lazy dog";
+
+  uint16_t u16[64];
+  uint32_t u32[64];
+  size_t n = 0;
+  for (const char *s = text; *s; n++) {
+    uint32_t c = (uint8_t)*s++;
+    if (c >= 0x80)
+      c = ((c & 0x1f) << 6) | (*s++ & 0x3f);
+    u16[n] = c;
+    u32[n] = c;
+  }
+
+  for (int pass = 0; pass < 2; pass++) {
+    UTFBUF_DEFINE_LOCAL(ub, 256, UTF_16);
+    utfbuf_set_translit(&ub, true);
+    if (pass)
+      ASSERT_EQ(utfbuf_write(&ub, u32, n * 4, UTF_32), 0);
+    else
+      ASSERT_EQ(utfbuf_write(&ub, u16, n * 2, UTF_16), 0);
+
+    ASSERT_EQ(utfbuf_length(&ub), 2 * strlen(expect));
+    for (size_t i = 0; expect[i]; i++) {
+      uint16_t cu;
+      memcpy(&cu, ub_storage + 2 * i, 2);
+      ASSERT_EQ(cu, expect[i]);
+    }
+  }
+}
+
+static void test_translit_sizing(void)
+{
+  const char *text = "\xef\xac\x81" "ancee's r\xc3\xa9sum\xc3\xa9 "
+    "\xe2\x91\xa0\xc2\xbd";  // ﬁancee's résumé ①½
+  const char *expect = "fiancee's resume 11/2";
+
+  // A counting buffer measures the transliterated output exactly.
+  utfbuf_t count;
+  ASSERT_EQ(utfbuf_init(&count, NULL, 0, UTF_8), 0);
+  utfbuf_set_translit(&count, true);
+  ASSERT_EQ(utfbuf_write(&count, text, strlen(text), UTF_8), 0);
+  ASSERT_EQ(utfbuf_overflow(&count), strlen(expect) + 1);
+
+  // Truncated output is a prefix of the transliterated text.
+  UTFBUF_DEFINE_LOCAL(ub, 3, UTF_8);
+  utfbuf_set_translit(&ub, true);
+  ASSERT_EQ(utfbuf_write(&ub, text, strlen(text), UTF_8), 0);
+  ASSERT_EQ(utfbuf_truncated(&ub), 1);
+  ASSERT_EQ(strcmp((const char *)ub_storage, "fi"), 0);
+}
+
+RUN_TESTS(
+    test_cp_translit,
+    test_write_translit,
+    test_write_translit_wide,
+    test_translit_sizing,
+)
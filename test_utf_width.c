@@ -0,0 +1,152 @@
+#include "utf_width.h"
+#include "test.h"
+#include "macros.h"
+
+#include <string.h>
+
+static size_t width8(const char *s)
+{
+  size_t w = 12345;
+  if (utf_display_width(s, strlen(s), UTF_8, &w))
+    return 54321;
+  return w;
+}
+
+static void test_cp_width(void)
+{
+  ASSERT_EQ(utf_cp_width('a'), 1);
+  ASSERT_EQ(utf_cp_width(0x65E5), 2);   // 日
+  ASSERT_EQ(utf_cp_width(0xFF21), 2);   // fullwidth A
+  ASSERT_EQ(utf_cp_width(0x0301), 0);   // combining acute
+  ASSERT_EQ(utf_cp_width(0x200B), 0);   // zero width space
+  ASSERT_EQ(utf_cp_width(0x1160), 0);   // Hangul jungseong filler
+  ASSERT_EQ(utf_cp_width(0x1F984), 2);  // unicorn
+  ASSERT_EQ(utf_cp_width(0x00AD), 1);   // soft hyphen
+  ASSERT_EQ(utf_cp_width('\n'), 0);
+}
+
+static void test_display_width(void)
+{
+  ASSERT_EQ(width8(""), 0);
+  ASSERT_EQ(width8("plain ascii that spans more than one vector"), 43);
+  ASSERT_EQ(width8("\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e"), 6);
+  ASSERT_EQ(width8("e\xcc\x81"), 1);
+  ASSERT_EQ(width8("tab\there"), 7);
+
+  // 👨‍👩‍👧: three pictographs joined by ZWJ.
+  ASSERT_EQ(width8("\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9"
+        "\xe2\x80\x8d\xf0\x9f\x91\xa7"), 2);
+
+  // 👍🏽: skin tone modifier.
+  ASSERT_EQ(width8("\xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd"), 2);
+
+  // ☺ is narrow; with U+FE0F it takes emoji presentation.
+  ASSERT_EQ(width8("\xe2\x98\xba"), 1);
+  ASSERT_EQ(width8("\xe2\x98\xba\xef\xb8\x8f"), 2);
+  ASSERT_EQ(width8("\xe2\x98\xba\xef\xb8\x8f\xef\xb8\x8f"), 2);
+
+  // Keycap: '#' U+FE0F U+20E3, straight after an ASCII run.
+  ASSERT_EQ(width8("0123456789abcdef#\xef\xb8\x8f\xe2\x83\xa3"), 18);
+
+  // ⌚ is wide; U+FE0E asks for text presentation.
+  ASSERT_EQ(width8("\xe2\x8c\x9a\xef\xb8\x8e"), 1);
+
+  // ZWJ between non-pictographs joins nothing.
+  ASSERT_EQ(width8("a\xe2\x80\x8d" "b"), 2);
+
+  static const uint16_t u16[] = { 0x65E5, 'x', 0xD83E, 0xDD84 };
+  size_t w;
+  ASSERT_EQ(utf_display_width(u16, sizeof(u16), UTF_16, &w),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(w, 5);
+
+  ASSERT_EQ(utf_display_width("a\xc3", 2, UTF_8, &w),
+      UTF_ERROR_INVALID_ARGUMENT);
+}
+
+static void test_write_columns(void)
+{
+  char buf[64];
+  utfbuf_t ub;
+  size_t cols;
+
+  // 日本語 in five columns: the third character would straddle.
+  const char *cjk = "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e";
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_columns(&ub, cjk, strlen(cjk), UTF_8, 5, &cols),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(cols, 4);
+  ASSERT_EQ(strcmp(buf, "\xe6\x97\xa5\xe6\x9c\xac"), 0);
+
+  // Combining marks stay with their base.
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_columns(&ub, "e\xcc\x81x", 4, UTF_8, 1, &cols),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(cols, 1);
+  ASSERT_EQ(strcmp(buf, "e\xcc\x81"), 0);
+
+  // ASCII is cut exactly, including inside the vector fast path.
+  const char *ascii = "0123456789abcdefghijklmnopqrstuvwxyz";
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_columns(&ub, ascii, strlen(ascii), UTF_8, 20,
+        &cols), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(cols, 20);
+  ASSERT_EQ(strcmp(buf, "0123456789abcdefghij"), 0);
+
+  // An emoji sequence is kept whole or not at all.
+  const char *family = "a\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9";
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_columns(&ub, family, strlen(family), UTF_8, 2,
+        &cols), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(cols, 1);
+  ASSERT_EQ(strcmp(buf, "a"), 0);
+
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_columns(&ub, family, strlen(family), UTF_8, 3,
+        &cols), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(cols, 3);
+  ASSERT_EQ(strcmp(buf, family), 0);
+
+  // U+2764 U+FE0F is two columns, and is not cut down to its
+  // one-column base.
+  const char *heart = "a\xe2\x9d\xa4\xef\xb8\x8f";
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_columns(&ub, heart + 1, strlen(heart + 1), UTF_8,
+        1, &cols), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(cols, 0);
+  ASSERT_EQ(strcmp(buf, ""), 0);
+
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_columns(&ub, heart, strlen(heart), UTF_8, 2,
+        &cols), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(cols, 1);
+  ASSERT_EQ(strcmp(buf, "a"), 0);
+
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_columns(&ub, heart, strlen(heart), UTF_8, 3,
+        &cols), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(cols, 3);
+  ASSERT_EQ(strcmp(buf, heart), 0);
+
+  // Likewise a keycap whose base is in the ASCII fast path.
+  const char *keycap = "x1\xef\xb8\x8f\xe2\x83\xa3";
+  utfbuf_init(&ub, buf, sizeof(buf), UTF_8);
+  ASSERT_EQ(utfbuf_write_columns(&ub, keycap, strlen(keycap), UTF_8, 2,
+        &cols), UTF_ERROR_SUCCESS);
+  ASSERT_EQ(cols, 1);
+  ASSERT_EQ(strcmp(buf, "x"), 0);
+
+  // Into another encoding.
+  uint32_t buf32[8];
+  utfbuf_init(&ub, buf32, sizeof(buf32), UTF_32);
+  ASSERT_EQ(utfbuf_write_columns(&ub, cjk, strlen(cjk), UTF_8, 2, NULL),
+      UTF_ERROR_SUCCESS);
+  ASSERT_EQ(buf32[0], 0x65E5);
+  ASSERT_EQ(buf32[1], 0);
+}
+
+RUN_TESTS(
+    test_cp_width,
+    test_display_width,
+    test_write_columns,
+)
@@ -0,0 +1,176 @@
+#include "utf_words.h"
+#include "test.h"
+
+#include <string.h>
+
+// Split UTF-8 text and join the slices with '|'.
+static const char *split(const char *text, unsigned flags)
+{
+  static char out[512];
+  utf_words_t it;
+  utf_slice_t words[4];
+  size_t n, at = 0;
+
+  out[0] = 0;
+  if (utf_words_init(&it, text, strlen(text), UTF_8, flags))
+    return "(init)";
+
+  // A small batch, so that segments are resumed across calls.
+  do {
+    if (utf_words_next(&it, words, ARRAY_LENGTH(words), &n))
+      return "(error)";
+    for (size_t i = 0; i < n; i++) {
+      if (at)
+        out[at++] = '|';
+      memcpy(out + at, text + words[i].offset, words[i].len);
+      at += words[i].len;
+      out[at] = 0;
+    }
+  } while (n);
+
+  return out;
+}
+
+static void test_words_ascii(void)
+{
+  // The example from UAX #29.
+  const char *text = "The quick (\"brown\") fox can't jump 32.3 feet, right?";
+  ASSERT_EQ(strcmp(split(text, 0),
+        "The|quick|brown|fox|can't|jump|32.3|feet|right"), 0);
+  ASSERT_EQ(strcmp(split(text, UTF_WORDS_ALL),
+        "The| |quick| |(|\"|brown|\"|)| |fox| |can't| |jump| |32.3| |"
+        "feet|,| |right|?"), 0);
+
+  ASSERT_EQ(strcmp(split("e.g. 1,234.56 a_b __ x--y", 0),
+        "e.g|1,234.56|a_b|x|y"), 0);
+  ASSERT_EQ(strcmp(split("a\r\n\nb  c", UTF_WORDS_ALL),
+        "a|\r\n|\n|b|  |c"), 0);
+  ASSERT_EQ(strcmp(split("", 0), ""), 0);
+  ASSERT_EQ(strcmp(split(" ,;!", 0), ""), 0);
+
+  // Longer than a vector on both sides of a word.
+  ASSERT_EQ(strcmp(split("internationalization_and_localization"
+          " ...................... Mid:letter's end.", 0),
+        "internationalization_and_localization|Mid:letter's|end"), 0);
+}
+
+static void test_words_unicode(void)
+{
+  // Letters with diacritics, ideographs one at a time, and no words
+  // in emoji or flags.
+  const char *text = "Gr\xc3\xbc\xc3\x9f" "e, \xe4\xb8\x96\xe7\x95\x8c! "
+    "\xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd \xf0\x9f\x87\xba\xf0\x9f\x87\xb8"
+    "\xf0\x9f\x87\xab\xf0\x9f\x87\xb7";
+  ASSERT_EQ(strcmp(split(text, 0),
+        "Gr\xc3\xbc\xc3\x9f" "e|\xe4\xb8\x96|\xe7\x95\x8c"), 0);
+
+  // Skin tone modifiers extend; flags pair up (WB15).
+  ASSERT_EQ(strcmp(split(text + 16, UTF_WORDS_ALL),
+        " |\xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd| |"
+        "\xf0\x9f\x87\xba\xf0\x9f\x87\xb8|\xf0\x9f\x87\xab\xf0\x9f\x87\xb7"),
+      0);
+
+  // Katakana runs (WB13), and a Hebrew acronym with a gershayim-like
+  // double quote (WB7b, WB7c).
+  ASSERT_EQ(strcmp(split("\xe3\x82\xab\xe3\x82\xbf\xe3\x82\xab\xe3\x83\x8a "
+          "\xd7\xa6\xd7\x94\"\xd7\x9c", 0),
+        "\xe3\x82\xab\xe3\x82\xbf\xe3\x82\xab\xe3\x83\x8a|"
+        "\xd7\xa6\xd7\x94\"\xd7\x9c"), 0);
+
+  // A combining accent after a separator, and inside a word (WB4).
+  ASSERT_EQ(strcmp(split("cafe\xcc\x81 \xcc\x81x", 0),
+        "cafe\xcc\x81|x"), 0);
+}
+
+static size_t to_wide(const char *utf8, utf_enc_t enc, uint8_t *out,
+    size_t size)
+{
+  utfbuf_t ub;
+  utfbuf_init(&ub, out, size, enc);
+  utfbuf_write_utf8_string(&ub, utf8);
+  return utfbuf_length(&ub);
+}
+
+static void test_words_wide(void)
+{
+  // The same words from every encoding, with the fast paths crossing
+  // non-ASCII.
+  const char *text = "  Normalisation des donn\xc3\xa9" "es -- "
+    "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e  tr\xc3\xa8s_bien 3.14159265358979";
+  const utf_enc_t encs[] = { UTF_8, UTF_16, UTF_32 };
+  size_t expect[8][2];
+
+  for (size_t e = 0; e < ARRAY_LENGTH(encs); e++) {
+    uint8_t mem[512];
+    const size_t len = to_wide(text, encs[e], mem, sizeof(mem));
+    utf_words_t it;
+    utf_slice_t words[16];
+    size_t n;
+
+    ASSERT_EQ(utf_words_init(&it, mem, len, encs[e], 0), 0);
+    ASSERT_EQ(utf_words_next(&it, words, ARRAY_LENGTH(words), &n), 0);
+    ASSERT_EQ(n, 8);
+
+    // Compare as codepoint offsets: count codepoints up to each slice.
+    for (size_t i = 0; i < n; i++) {
+      utfbuf_t ub;
+      utfbuf_init(&ub, NULL, 0, UTF_32);
+      utfbuf_write(&ub, mem, words[i].offset, encs[e]);
+      const size_t start = utfbuf_overflow(&ub) / 4;
+      utfbuf_write(&ub, mem + words[i].offset, words[i].len, encs[e]);
+      const size_t end = utfbuf_overflow(&ub) / 4;
+      if (!e) {
+        expect[i][0] = start;
+        expect[i][1] = end;
+      }
+      ASSERT_EQ(start, expect[i][0]);
+      ASSERT_EQ(end, expect[i][1]);
+    }
+
+    ASSERT_EQ(utf_words_next(&it, words, ARRAY_LENGTH(words), &n), 0);
+    ASSERT_EQ(n, 0);
+  }
+
+  // Normalisation, des, données, 日, 本, 語, très_bien, 3.14159265358979
+  ASSERT_EQ(expect[7][1] - expect[7][0], 16);
+}
+
+static bool count_words(utf_slice_t word, void *ctx)
+{
+  size_t *count = ctx;
+  (void)word;
+  return ++*count < 3;
+}
+
+static void test_words_each_and_errors(void)
+{
+  size_t count = 0;
+  ASSERT_EQ(utf_words_each("one two three four", 18, UTF_8, 0,
+        count_words, &count), 0);
+  ASSERT_EQ(count, 3);
+
+  // Words before malformed input are reported, then the error.
+  const char *bad = "abc def\xff ghi";
+  utf_words_t it;
+  utf_slice_t words[8];
+  size_t n;
+  ASSERT_EQ(utf_words_init(&it, bad, strlen(bad), UTF_8, 0), 0);
+  ASSERT_EQ(utf_words_next(&it, words, ARRAY_LENGTH(words), &n),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(n, 2);
+  ASSERT_EQ(words[1].offset, 4);
+  ASSERT_EQ(words[1].len, 3);
+  ASSERT_EQ(it.pos, 7);
+
+  ASSERT_EQ(utf_words_init(&it, "abc", 3, UTF_16, 0),
+      UTF_ERROR_INVALID_ARGUMENT);
+  ASSERT_EQ(utf_words_init(&it, "abc", 3, UTF_BIG5, 0),
+      UTF_ERROR_INVALID_ARGUMENT);
+}
+
+RUN_TESTS(
+    test_words_ascii,
+    test_words_unicode,
+    test_words_wide,
+    test_words_each_and_errors,
+)
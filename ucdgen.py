@@ -0,0 +1,494 @@
+#!/usr/bin/env python3
+
+# Generates compact Unicode property tables from the data files in
+# ucd/. Invoked by the build (see configure.py) as:
+#
+#   ucdgen.py <table> <output header>
+
+import os
+import sys
+
+UCD_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "ucd")
+MAX_CP = 0x110000
+
+
+def read_ucd(name):
+  """Yields (first, last, fields) for each data line of a UCD file."""
+  with open(os.path.join(UCD_DIR, name), encoding="utf-8") as f:
+    for line in f:
+      line = line.split("#", 1)[0].strip()
+      if not line:
+        continue
+      fields = [x.strip() for x in line.split(";")]
+      cps = fields[0].split("..")
+      first = int(cps[0], 16)
+      last = int(cps[-1], 16)
+      yield first, last, fields[1:]
+
+
+def read_map(name, default):
+  """Reads a <range> ; <value> file into a per-codepoint list."""
+  values = [default] * MAX_CP
+  for first, last, fields in read_ucd(name):
+    for cp in range(first, last + 1):
+      values[cp] = fields[0]
+  return values
+
+
+def read_binary(name, prop):
+  """Reads one binary property from a multi-property file."""
+  values = [False] * MAX_CP
+  for first, last, fields in read_ucd(name):
+    if fields[0] == prop:
+      for cp in range(first, last + 1):
+        values[cp] = True
+  return values
+
+
+class Trie:
+  """Three-stage lookup table. The codepoint is split into three bit
+  fields: stage1[hi] selects a block of stage2, whose entry at mid
+  selects a block of stage3 holding the values for the lo bits.
+  Identical blocks are shared at both levels, and the field widths
+  are chosen to minimise the total size."""
+
+  def __init__(self, values, value_bits=8):
+    self.value_type = "uint8_t" if value_bits <= 8 else "uint16_t"
+    self.limit = len(values)
+    best = None
+    for shift3 in range(3, 9):
+      index3, stage3 = self.dedupe(values, shift3)
+      for shift2 in range(2, 8):
+        index2, stage2 = self.dedupe(index3, shift2)
+        cand = self.layout(shift2, shift3, index2, stage2, stage3)
+        if best is None or cand["size"] < best["size"]:
+          best = cand
+    self.__dict__.update(best)
+
+  @staticmethod
+  def dedupe(values, shift):
+    """Splits values into blocks of 1 << shift, returning the block
+    index of each one and the concatenation of the distinct blocks."""
+    block = 1 << shift
+    blocks = {}
+    index = []
+    flat = []
+    for base in range(0, len(values), block):
+      key = tuple(values[base:base + block])
+      if key not in blocks:
+        blocks[key] = len(blocks)
+        flat.extend(key)
+      index.append(blocks[key])
+    return index, flat
+
+  def layout(self, shift2, shift3, stage1, stage2, stage3):
+    def index_type(n):
+      return "uint8_t" if n <= 256 else "uint16_t"
+
+    type1 = index_type(len(stage2) >> shift2)
+    type2 = index_type(len(stage3) >> shift3)
+    size = lambda t: 1 if t == "uint8_t" else 2
+    return {
+      "shift2": shift2,
+      "shift3": shift3,
+      "stage1": stage1,
+      "stage2": stage2,
+      "stage3": stage3,
+      "type1": type1,
+      "type2": type2,
+      "size": len(stage1) * size(type1) + len(stage2) * size(type2) +
+          len(stage3) * size(self.value_type),
+    }
+
+  def emit(self, out, name, key="cp"):
+    upper = name.upper()
+    out.append("#define %s_SHIFT2 %d" % (upper, self.shift2))
+    out.append("#define %s_SHIFT3 %d" % (upper, self.shift3))
+    out.append("#define %s_BYTES %d" % (upper, self.size))
+    out.append("")
+    emit_array(out, "static const %s %s_stage1[]" % (self.type1, name),
+        self.stage1)
+    emit_array(out, "static const %s %s_stage2[]" % (self.type2, name),
+        self.stage2)
+    emit_array(out, "static const %s %s_stage3[]" % (self.value_type, name),
+        self.stage3)
+    out.append("static inline %s %s_lookup(uint32_t %s)" %
+        (self.value_type, name, key))
+    out.append("{")
+    out.append("  if (%s >= 0x%x)" % (key, self.limit))
+    out.append("    return 0;")
+    out.append("  size_t i = %s_stage1[%s >> %d];" %
+        (name, key, self.shift2 + self.shift3))
+    out.append("  i = %s_stage2[(i << %d) | ((%s >> %d) & 0x%x)];" %
+        (name, self.shift2, key, self.shift3, (1 << self.shift2) - 1))
+    out.append("  return %s_stage3[(i << %d) | (%s & 0x%x)];" %
+        (name, self.shift3, key, (1 << self.shift3) - 1))
+    out.append("}")
+    out.append("")
+
+
+def emit_array(out, decl, values, per_line=16):
+  out.append("%s = {" % decl)
+  for i in range(0, len(values), per_line):
+    out.append("  " + ", ".join(str(v) for v in values[i:i + per_line]) + ",")
+  out.append("};")
+  out.append("")
+
+
+# {{{ width
+
+WIDTH_EXT_PICT = 0x4
+WIDTH_EMOJI = 0x8
+WIDTH_EMOJI_PRES = 0x10
+
+
+def gen_width(out):
+  eaw = read_map("EastAsianWidth.txt", "N")
+  gc = read_map("DerivedGeneralCategory.txt", "Cn")
+  ext_pict = read_binary("emoji-data.txt", "Extended_Pictographic")
+  emoji = read_binary("emoji-data.txt", "Emoji")
+  emoji_pres = read_binary("emoji-data.txt", "Emoji_Presentation")
+
+  values = []
+  for cp in range(MAX_CP):
+    if gc[cp] in ("Mn", "Me", "Cf", "Cc") and cp != 0xAD:
+      w = 0
+    elif 0x1160 <= cp <= 0x11FF:
+      # Hangul medial vowels and final consonants combine.
+      w = 0
+    elif eaw[cp] in ("W", "F"):
+      w = 2
+    else:
+      w = 1
+
+    v = w
+    if ext_pict[cp]:
+      v |= WIDTH_EXT_PICT
+    if emoji[cp]:
+      v |= WIDTH_EMOJI
+    if emoji_pres[cp]:
+      v |= WIDTH_EMOJI_PRES
+    values.append(v)
+
+  out.append("// Per-codepoint display width (bits 0-1) and emoji flags.")
+  out.append("#define UTF_WIDTH_EXT_PICT 0x%x" % WIDTH_EXT_PICT)
+  out.append("#define UTF_WIDTH_EMOJI 0x%x" % WIDTH_EMOJI)
+  out.append("#define UTF_WIDTH_EMOJI_PRES 0x%x" % WIDTH_EMOJI_PRES)
+  out.append("")
+  Trie(values).emit(out, "utf_width")
+
+# }}}
+
+# {{{ props
+
+# Must match utf_category_t in utf_props.h.
+CATEGORIES = [
+  "Cn", "Lu", "Ll", "Lt", "Lm", "Lo", "Mn", "Mc", "Me", "Nd", "Nl", "No",
+  "Pc", "Pd", "Ps", "Pe", "Pi", "Pf", "Po", "Sm", "Sc", "Sk", "So",
+  "Zs", "Zl", "Zp", "Cc", "Cf", "Cs", "Co",
+]
+
+
+def script_names():
+  """Script values in enum order: Unknown first, the rest sorted."""
+  names = set(fields[0] for _, _, fields in read_ucd("Scripts.txt"))
+  names.discard("Unknown")
+  return ["Unknown"] + sorted(names)
+
+
+def gen_props(out):
+  gc = read_map("DerivedGeneralCategory.txt", "Cn")
+  sc = read_map("Scripts.txt", "Unknown")
+  gc_ids = {name: i for i, name in enumerate(CATEGORIES)}
+  sc_ids = {name: i for i, name in enumerate(script_names())}
+  categories = [gc_ids[v] for v in gc]
+  scripts = [sc_ids[v] for v in sc]
+
+  out.append("// General category and script of each codepoint, as")
+  out.append("// utf_category_t and utf_script_t values.")
+  out.append("")
+  Trie(categories).emit(out, "utf_category")
+  Trie(scripts).emit(out, "utf_script")
+  emit_array(out, "static const uint8_t utf_category_ascii[128]",
+      categories[:128])
+  emit_array(out, "static const uint8_t utf_script_ascii[128]",
+      scripts[:128])
+  emit_array(out, "static const char *const utf_category_names[]",
+      ['"%s"' % name for name in CATEGORIES], per_line=8)
+  emit_array(out, "static const char *const utf_script_names[]",
+      ['"%s"' % name for name in script_names()], per_line=4)
+
+
+def gen_scripts(out):
+  out.append("// Unicode scripts, as listed in ucd/Scripts.txt.")
+  out.append("typedef enum {")
+  for i, name in enumerate(script_names()):
+    out.append("  UTF_SCRIPT_%s = %d," % (name.upper(), i))
+  out.append("  UTF_SCRIPT_COUNT")
+  out.append("} utf_script_t;")
+  out.append("")
+
+# }}}
+
+# {{{ fold
+
+def gen_fold(out):
+  # Full case folding: statuses C and F. Each distinct mapping gets a
+  # row of utf_fold_data; the trie maps codepoints to rows, with row 0
+  # meaning the codepoint folds to itself. A mapping to a single
+  # codepoint is stored as an offset from the source codepoint, so
+  # that e.g. all of A-Z share one row.
+  rows = [(0, 0, 0)]
+  row_of = {}
+  values = [0] * MAX_CP
+  for first, _, fields in read_ucd("CaseFolding.txt"):
+    status, mapping = fields[0], fields[1]
+    if status not in ("C", "F"):
+      continue
+    cps = tuple(int(x, 16) for x in mapping.split())
+    if len(cps) == 1:
+      cps = ((cps[0] - first) & 0xffffffff,)
+    cps += (0,) * (3 - len(cps))
+    if cps not in row_of:
+      row_of[cps] = len(rows)
+      rows.append(cps)
+    values[first] = row_of[cps]
+
+  out.append("// Full case folding: up to three codepoints per codepoint.")
+  out.append("// Rows with a single entry hold an offset from the source.")
+  out.append("")
+  value_bits = 8 if len(rows) <= 256 else 16
+  Trie(values, value_bits).emit(out, "utf_fold")
+  out.append("static const uint32_t utf_fold_data[][3] = {")
+  for row in rows:
+    out.append("  { 0x%x, 0x%x, 0x%x }," % row)
+  out.append("};")
+  out.append("")
+
+# }}}
+
+# {{{ legacy
+
+# Double-byte sequences are numbered by pointer: lead bytes 81-FE and
+# trail bytes 40-FE, row by row. Must match utf_legacy.c.
+LEGACY_LEAD = 0x81
+LEGACY_TRAIL = 0x40
+LEGACY_TRAILS = 0xFF - LEGACY_TRAIL
+LEGACY_POINTERS = (0xFF - LEGACY_LEAD) * LEGACY_TRAILS
+
+LEGACY = [
+  ("sjis", "index-shift_jis.txt"),
+  ("euckr", "index-euc_kr.txt"),
+  ("gb18030", "index-gb18030.txt"),
+  ("big5", "index-big5.txt"),
+]
+
+
+def gb18030_pointer(seq):
+  """Linear index of a four-byte GB18030 sequence."""
+  b = seq.to_bytes(4, "big")
+  return (((b[0] - 0x81) * 10 + b[1] - 0x30) * 126 + b[2] - 0x81) * 10 + \
+      b[3] - 0x30
+
+
+def gen_legacy(out):
+  # Per encoding: the codepoint of each single byte 80-FF (0 if it is
+  # not one), a trie from pointer to codepoint, and a trie from BMP
+  # codepoint to the bytes the encoder produces: a single byte
+  # 80-FF, or 0x100 + pointer.
+  out.append("// Legacy CJK encodings; see utf_legacy.c.")
+  out.append("#define UTF_LEGACY_LEAD 0x%X" % LEGACY_LEAD)
+  out.append("#define UTF_LEGACY_TRAIL 0x%X" % LEGACY_TRAIL)
+  out.append("#define UTF_LEGACY_TRAILS %d" % LEGACY_TRAILS)
+  out.append("")
+  for name, path in LEGACY:
+    single = [0] * 0x80
+    decode = [0] * LEGACY_POINTERS
+    encode = [0] * 0x10000
+    for seq, _, fields in read_ucd(path):
+      cp = int(fields[0], 16)
+      if seq < 0x100:
+        single[seq - 0x80] = cp
+        value = seq
+      else:
+        lead, trail = seq >> 8, seq & 0xff
+        ptr = (lead - LEGACY_LEAD) * LEGACY_TRAILS + trail - LEGACY_TRAIL
+        decode[ptr] = cp
+        value = 0x100 + ptr
+      if fields[1:] != ["D"]:
+        encode[cp] = value
+
+    emit_array(out, "static const uint16_t utf_%s_single[128]" % name,
+        single)
+    Trie(decode, 16).emit(out, "utf_%s_decode" % name, key="ptr")
+    Trie(encode, 16).emit(out, "utf_%s_encode" % name)
+
+  # Four-byte GB18030 in the BMP: runs of consecutive codepoints,
+  # sorted by both pointer and codepoint.
+  ptrs, cps = [], []
+  for seq, _, fields in read_ucd("index-gb18030-ranges.txt"):
+    ptrs.append(gb18030_pointer(seq))
+    cps.append(int(fields[0], 16))
+  out.append("#define UTF_GB18030_RANGES %d" % len(ptrs))
+  out.append("#define UTF_GB18030_BMP_POINTERS %d" %
+      (gb18030_pointer(0x8431A439) + 1))
+  out.append("#define UTF_GB18030_SUPP_POINTER %d" %
+      gb18030_pointer(0x90308130))
+  out.append("")
+  emit_array(out, "static const uint16_t utf_gb18030_range_ptr[]", ptrs)
+  emit_array(out, "static const uint16_t utf_gb18030_range_cp[]", cps)
+
+# }}}
+
+# {{{ translit
+
+# Combining diacritical mark blocks. Marks from these are dropped by
+# transliteration; marks of other scripts are left alone.
+DIACRITICS = [
+  (0x0300, 0x036F), (0x1AB0, 0x1AFF), (0x1DC0, 0x1DFF), (0x20D0, 0x20FF),
+  (0xFE20, 0xFE2F),
+]
+
+
+def gen_translit(out):
+  decomp = {}
+  for cp, _, fields in read_ucd("Decomposition.txt"):
+    parts = fields[0].split()
+    if parts[0].startswith("<"):
+      parts = parts[1:]
+    decomp[cp] = [int(x, 16) for x in parts]
+  extra = {cp: fields[0]
+      for cp, _, fields in read_ucd("translit-extra.txt")}
+
+  def is_diacritic(cp):
+    return any(lo <= cp <= hi for lo, hi in DIACRITICS)
+
+  def ascii_of(cp):
+    """ASCII replacement of cp, or None if it has none."""
+    if cp < 0x80:
+      return chr(cp)
+    if cp in extra:
+      return extra[cp]
+    if is_diacritic(cp):
+      return ""
+    if cp not in decomp:
+      return None
+    parts = decomp[cp]
+    if parts[0] == 0x20 and len(parts) > 1:
+      # A spacing clone of a diacritic, such as U+00A8 DIAERESIS.
+      return None
+    parts = [ascii_of(c) for c in parts]
+    return None if None in parts else "".join(parts)
+
+  # Row 0 means no replacement; the other rows are distinct
+  # replacements, stored as (offset, length) into one pool.
+  rows = [None]
+  row_of = {}
+  values = [0] * MAX_CP
+  for cp in range(0x80, MAX_CP):
+    s = ascii_of(cp)
+    if s is None:
+      continue
+    if s not in row_of:
+      row_of[s] = len(rows)
+      rows.append(s)
+    values[cp] = row_of[s]
+
+  pool = ""
+  spans = [(0, 0)]
+  for s in rows[1:]:
+    at = pool.find(s) if s else 0
+    if at < 0:
+      at = len(pool)
+      pool += s
+    spans.append((at, len(s)))
+
+  out.append("// ASCII transliteration of non-ASCII codepoints: a trie to")
+  out.append("// rows of (offset, length) in utf_translit_pool. Row 0 means")
+  out.append("// the codepoint has no transliteration.")
+  out.append("#define UTF_TRANSLIT_MAX %d" % max(len(s) for s in rows[1:]))
+  out.append("")
+  value_bits = 8 if len(rows) <= 256 else 16
+  Trie(values, value_bits).emit(out, "utf_translit")
+  out.append("static const uint16_t utf_translit_rows[][2] = {")
+  for span in spans:
+    out.append("  { %d, %d }," % span)
+  out.append("};")
+  out.append("")
+  emit_array(out, "static const char utf_translit_pool[]",
+      [ord(c) for c in pool])
+
+# }}}
+
+# {{{ words
+
+# Word_Break values, in the order of the UTF_WB_* constants.
+WORD_BREAKS = [
+  "Other", "CR", "LF", "Newline", "Extend", "ZWJ", "Regional_Indicator",
+  "Format", "Katakana", "Hebrew_Letter", "ALetter", "Single_Quote",
+  "Double_Quote", "MidNumLet", "MidLetter", "MidNum", "Numeric",
+  "ExtendNumLet", "WSegSpace",
+]
+WB_WORD = 0x20
+WB_EXT_PICT = 0x40
+
+
+def gen_words(out):
+  wb = read_map("WordBreakProperty.txt", "Other")
+  gc = read_map("DerivedGeneralCategory.txt", "Cn")
+  ext_pict = read_binary("emoji-data.txt", "Extended_Pictographic")
+  ids = {name: i for i, name in enumerate(WORD_BREAKS)}
+
+  values = []
+  for cp in range(MAX_CP):
+    v = ids[wb[cp]]
+    if gc[cp][0] in "LN":
+      v |= WB_WORD
+    if ext_pict[cp]:
+      v |= WB_EXT_PICT
+    values.append(v)
+
+  out.append("// Word_Break property (UAX #29) of each codepoint in the low")
+  out.append("// bits, with flags for letters and numbers (general category L")
+  out.append("// or N) and for Extended_Pictographic.")
+  for i, name in enumerate(WORD_BREAKS):
+    out.append("#define UTF_WB_%s %d" % (name.upper(), i))
+  out.append("#define UTF_WB_MASK 0x1f")
+  out.append("#define UTF_WB_WORD 0x%x" % WB_WORD)
+  out.append("#define UTF_WB_EXT_PICT 0x%x" % WB_EXT_PICT)
+  out.append("")
+  Trie(values).emit(out, "utf_wb")
+  emit_array(out, "static const uint8_t utf_wb_ascii[128]", values[:128])
+
+# }}}
+
+GENERATORS = {
+  "width": gen_width,
+  "props": gen_props,
+  "scripts": gen_scripts,
+  "fold": gen_fold,
+  "legacy": gen_legacy,
+  "translit": gen_translit,
+  "words": gen_words,
+}
+
+
+def main():
+  table, path = sys.argv[1], sys.argv[2]
+  out = [
+    "// auto-generated by ucdgen.py from ucd/; do not edit.",
+    "#pragma once",
+    "",
+    "#include <stddef.h>",
+    "#include <stdint.h>",
+    "",
+  ]
+  GENERATORS[table](out)
+  with open(path, "w") as f:
+    f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+  main()
+
+# vim: foldmethod=marker
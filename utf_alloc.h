@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// Caller-supplied allocator for the few structures which must grow on
+// their own. A single realloc-style hook: size 0 frees ptr. A NULL
+// utf_alloc_t means the C library's realloc/free.
+typedef struct {
+  void *(*realloc)(void *ctx, void *ptr, size_t size);
+  void *ctx;
+} utf_alloc_t;
+
+static inline void *utf_realloc(const utf_alloc_t *alloc,
+    void *ptr, size_t size)
+{
+  if (alloc)
+    return alloc->realloc(alloc->ctx, ptr, size);
+
+  if (!size) {
+    free(ptr);
+    return NULL;
+  }
+
+  return realloc(ptr, size);
+}
+
+static inline void utf_free(const utf_alloc_t *alloc, void *ptr)
+{
+  if (ptr)
+    utf_realloc(alloc, ptr, 0);
+}
@@ -1,11 +1,16 @@
 #include "debug.h"
 #include "minmax.h"
 #include "utf_buffer.h"
+#include "utf_codec.h"
+#include "utf_legacy.h"
+#include "utf_simd.h"
+#include "utf_translit.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <sys/uio.h>
 
 static size_t ub_bytes_remaining(utfbuf_t *ub)
 {
@@ -25,6 +30,13 @@ static void ub_write_entire_pattern(utfbuf_t *ub,
   }
 }
 
+// A counting utfbuf has no memory at all and only accumulates
+// overflow, so that callers can size a real buffer.
+static bool ub_is_counting(const utfbuf_t *ub)
+{
+  return !ub->size && !ub->segs;
+}
+
 static void ub_write_null(utfbuf_t *ub)
 {
   ub_write_entire_pattern(ub, 0x0, utf_bytes(ub->enc));
@@ -37,6 +49,10 @@ utf_error_t utfbuf_init(utfbuf_t *ub,
   case UTF_8:
   case UTF_16:
   case UTF_32:
+  case UTF_SHIFT_JIS:
+  case UTF_EUC_KR:
+  case UTF_GB18030:
+  case UTF_BIG5:
     break;
   default:
     return UTF_ERROR_INVALID_ARGUMENT;
@@ -52,9 +68,105 @@ utf_error_t utfbuf_init(utfbuf_t *ub,
   return UTF_ERROR_SUCCESS;
 }
 
+utf_error_t utfbuf_init_segmented(utfbuf_t *ub,
+    struct iovec *segs, size_t n_segs, utf_enc_t encoding,
+    unsigned flags)
+{
+  switch (encoding) {
+  case UTF_8:
+  case UTF_16:
+  case UTF_32:
+  case UTF_SHIFT_JIS:
+  case UTF_EUC_KR:
+  case UTF_GB18030:
+  case UTF_BIG5:
+    break;
+  default:
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (!n_segs)
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  // No null terminator in segmented mode: the output is consumed
+  // as an iovec, not as a C string.
+  *ub = (utfbuf_t){
+    .start = segs[0].iov_base,
+    .size = segs[0].iov_len,
+    .enc = encoding,
+    .segs = segs,
+    .n_segs = n_segs,
+    .seg_flags = flags,
+  };
+
+  return UTF_ERROR_SUCCESS;
+}
+
+// Close off the current segment and move on to the next one. The
+// segment's iov_len is rewritten from its capacity to the number of
+// bytes used.
+static bool ub_next_segment(utfbuf_t *ub)
+{
+  if (ub->seg + 1 >= ub->n_segs)
+    return false;
+
+  ub->segs[ub->seg].iov_len = ub->pos;
+  ub->seg_base += ub->pos;
+  ub->seg++;
+
+  ub->start = ub->segs[ub->seg].iov_base;
+  ub->size = ub->segs[ub->seg].iov_len;
+  ub->pos = 0;
+  return true;
+}
+
+static void ub_write_segmented(utfbuf_t *ub,
+    const uint8_t *utf, size_t required)
+{
+  if (ub->overflow) {
+    // Keep the output a prefix of the input: once something has
+    // been dropped, drop everything after it too.
+    ub->overflow += required;
+    return;
+  }
+
+  if (ub->seg_flags & UTFBUF_SEG_SPLIT) {
+    while (required) {
+      const size_t n = min_zu(required, ub_bytes_remaining(ub));
+      memcpy(ub->start + ub->pos, utf, n);
+      ub->pos += n;
+      utf += n;
+      required -= n;
+
+      if (required && !ub_next_segment(ub)) {
+        ub->overflow += required;
+        return;
+      }
+    }
+    return;
+  }
+
+  // Never split a codepoint: skip to the first segment which can
+  // hold it whole.
+  while (ub_bytes_remaining(ub) < required) {
+    if (!ub_next_segment(ub)) {
+      ub->overflow += required;
+      return;
+    }
+  }
+
+  memcpy(ub->start + ub->pos, utf, required);
+  ub->pos += required;
+}
+
 static void write_utf_internal(utfbuf_t *ub,
     const void *utf, uint8_t n, utf_enc_t enc)
 {
+  if (ub->segs) {
+    ub_write_segmented(ub, utf, n * utf_bytes(enc));
+    return;
+  }
+
   const uint8_t width = utf_bytes(enc);
   const size_t required = n * width;
   const size_t avail = ub_bytes_remaining(ub);
@@ -73,9 +185,8 @@ static const uint8_t utf8_mask_table[] = {
   0x7f, 0x1f, 0x0f, 0x07,
 };
 
-static void ub_write_utf8_of_utf32(utfbuf_t *ub)
+static void ub_write_utf8_of_utf32(utfbuf_t *ub, uint32_t u32)
 {
-  uint32_t u32 = ub->in.u32[0];
   uint8_t u8[4] = { 0 };
   uint8_t count, i;
 
@@ -83,7 +194,7 @@ static void ub_write_utf8_of_utf32(utfbuf_t *ub)
     0x7f, 0x7ff, 0xffff
   };
   for (count = 1; count < 4; count++) {
-    if (u32 < limits[count-1])
+    if (u32 <= limits[count-1])
       break;
   }
 
@@ -102,10 +213,26 @@ static void ub_write_utf8_of_utf32(utfbuf_t *ub)
   write_utf_internal(ub, u8, count, UTF_8);
 }
 
-static void ub_write_utf32_of_utf8(utfbuf_t *ub)
+static void ub_write_utf16_of_utf32(utfbuf_t *ub, uint32_t u32)
 {
-  const uint8_t *u8 = ub->in.u8;
-  const uint8_t n = ub->in.count;
+  uint16_t u16[2];
+
+  if (u32 < 0x10000) {
+    u16[0] = u32;
+    write_utf_internal(ub, u16, 1, UTF_16);
+    return;
+  }
+
+  u32 -= 0x10000;
+  u16[0] = 0xD800 | (u32 >> 10);
+  u16[1] = 0xDC00 | (u32 & 0x3ff);
+  write_utf_internal(ub, u16, 2, UTF_16);
+}
+
+static uint32_t ub_utf32_of_utf8(const ub_inbuf_t *in)
+{
+  const uint8_t *u8 = in->u8;
+  const uint8_t n = in->count;
 
   uint32_t out = 0;
   uint8_t bits = 0;
@@ -116,66 +243,90 @@ static void ub_write_utf32_of_utf8(utfbuf_t *ub)
   }
   out |= (u8[0] & utf8_mask_table[n-1]) << bits;
 
-  write_utf_internal(ub, &out, 1, UTF_32);
+  return out;
 }
 
-static void ub_write_utf8_cp(utfbuf_t *ub)
+static uint32_t ub_utf32_of_utf16(const ub_inbuf_t *in)
 {
-  switch (ub->enc) {
-    case UTF_8:
-      write_utf_internal(ub, ub->in.u8, ub->in.count, UTF_8);
-      break;
-    case UTF_32:
-      ub_write_utf32_of_utf8(ub);
-      break;
-    default:
-      UTF_RASSERT(0, "encoding %u", ub->enc);
-  }
+  if (in->count == 1)
+    return in->u16[0];
+
+  return 0x10000
+    + ((uint32_t)(in->u16[0] - 0xD800) << 10)
+    + (in->u16[1] - 0xDC00);
 }
 
-static void ub_write_utf32_cp(utfbuf_t *ub)
+static uint32_t ub_utf32_of_inbuf(const ub_inbuf_t *in)
 {
-  switch (ub->enc) {
+  switch (in->enc) {
     case UTF_8:
-      ub_write_utf8_of_utf32(ub);
-      break;
+      return ub_utf32_of_utf8(in);
+    case UTF_16:
+      return ub_utf32_of_utf16(in);
     case UTF_32:
-      write_utf_internal(ub, &ub->in.u32, 1, UTF_32);
-      break;
-    default:
-      UTF_RASSERT(0, "encoding %u", ub->enc);
+      return in->u32[0];
+    default: {
+      // A complete legacy sequence: see utfbuf_write_legacy.
+      uint32_t cp = 0;
+      const int n = utf_legacy_decode(in->enc, in->u8, in->count, &cp);
+      UTF_RASSERT(n > 0, "encoding %u", in->enc);
+      return cp;
+    }
   }
 }
 
-static void ub_write_utf16_cp(utfbuf_t *ub)
+static utf_error_t ub_write_legacy_of_utf32(utfbuf_t *ub, uint32_t u32)
 {
-  switch (ub->enc) {
-    case UTF_16:
-      write_utf_internal(ub,
-          ub->in.u16, ub->in.count, UTF_16);
-      break;
-    default:
-      UTF_RASSERT(0, "encoding %u", ub->enc);
-  }
+  uint8_t bytes[4];
+  const size_t n = utf_legacy_encode(ub->enc, u32, bytes);
+  if (!n)
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  write_utf_internal(ub, bytes, n, ub->enc);
+  return UTF_ERROR_SUCCESS;
 }
 
-static void ub_write_codepoint(utfbuf_t *ub)
+static utf_error_t ub_write_codepoint(utfbuf_t *ub)
 {
-  switch (ub->in.enc) {
+  utf_error_t err = UTF_ERROR_SUCCESS;
+
+  if (ub->translit) {
+    const uint32_t cp = ub_utf32_of_inbuf(&ub->in);
+    const char *ascii;
+    size_t n;
+    if (cp >= 0x80 && utf_cp_translit(cp, &ascii, &n)) {
+      ub->in = (ub_inbuf_t) { 0 };
+      return utfbuf_write_ascii(ub, ascii, n);
+    }
+  }
+
+  if (ub->in.enc == ub->enc) {
+    // No transcoding required: copy the code units verbatim.
+    write_utf_internal(ub, ub->in.u8, ub->in.count, ub->enc);
+    ub->in = (ub_inbuf_t) { 0 };
+    return err;
+  }
+
+  const uint32_t u32 = ub_utf32_of_inbuf(&ub->in);
+
+  switch (ub->enc) {
     case UTF_8:
-      ub_write_utf8_cp(ub);
+      ub_write_utf8_of_utf32(ub, u32);
       break;
     case UTF_16:
-      ub_write_utf16_cp(ub);
+      ub_write_utf16_of_utf32(ub, u32);
       break;
     case UTF_32:
-      ub_write_utf32_cp(ub);
+      write_utf_internal(ub, &u32, 1, UTF_32);
       break;
     default:
-      UTF_RASSERT(0, "encoding %u", ub->in.enc);
+      // Not every codepoint has a legacy mapping.
+      err = ub_write_legacy_of_utf32(ub, u32);
+      break;
   }
 
   ub->in = (ub_inbuf_t) { 0 };
+  return err;
 }
 
 static uint8_t count_bits_u8(uint8_t byte)
@@ -193,7 +344,6 @@ static uint8_t count_bits_u8(uint8_t byte)
 
 utf_error_t utfbuf_write_utf8_string(utfbuf_t *ub, const char *str)
 {
-  const bool real_ub = !!ub->size;
   utf_error_t err;
 
   for (size_t i = 0; str[i]; i++) {
@@ -201,7 +351,7 @@ utf_error_t utfbuf_write_utf8_string(utfbuf_t *ub, const char *str)
     if (err)
       return err;
 
-    if (real_ub && utfbuf_overflow(ub)) {
+    if (utfbuf_truncated(ub)) {
       // If we're not just a 'byte counting' utfbuf,
       // and we've overflowed, then refuse to
       // write any more.
@@ -214,10 +364,6 @@ utf_error_t utfbuf_write_utf8_string(utfbuf_t *ub, const char *str)
 
 utf_error_t utfbuf_write_utf8(utfbuf_t *ub, uint8_t byte)
 {
-  if (ub->enc == UTF_16) {
-    return UTF_ERROR_NOT_IMPLEMENTED;
-  }
-
   const uint8_t count = count_bits_u8(byte);
   if (!ub->in.enc) {
     switch (count) {
@@ -225,8 +371,7 @@ utf_error_t utfbuf_write_utf8(utfbuf_t *ub, uint8_t byte)
         ub->in.enc = UTF_8;
         ub->in.u8[0] = byte;
         ub->in.count = 1;
-        ub_write_codepoint(ub);
-        return UTF_ERROR_SUCCESS;
+        return ub_write_codepoint(ub);
       case 2:
       case 3:
       case 4:
@@ -258,7 +403,18 @@ utf_error_t utfbuf_write_utf8(utfbuf_t *ub, uint8_t byte)
   ub->in.u8[i] = byte;
 
   if (i+1 == ub->in.count) {
-    ub_write_codepoint(ub);
+    static const uint32_t min_cp[] = {
+      0x0, 0x80, 0x800, 0x10000,
+    };
+    const uint32_t cp = ub_utf32_of_utf8(&ub->in);
+    if (cp < min_cp[i] || cp > 0x10FFFF
+        || (cp >= 0xD800 && cp <= 0xDFFF)) {
+      // Overlong encoding, surrogate, or out of range.
+      ub->in = (ub_inbuf_t){ 0 };
+      return UTF_ERROR_INVALID_ARGUMENT;
+    }
+
+    return ub_write_codepoint(ub);
   } else {
     UTF_RASSERT(i+1 < ub->in.count);
   }
@@ -266,6 +422,54 @@ utf_error_t utfbuf_write_utf8(utfbuf_t *ub, uint8_t byte)
   return UTF_ERROR_SUCCESS;
 }
 
+utf_error_t utfbuf_write_ascii(utfbuf_t *ub, const char *str, size_t n)
+{
+  if (ub->in.enc) {
+    // Mid-codepoint.
+    ub->in = (ub_inbuf_t){ 0 };
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+
+  const uint8_t width = utf_bytes(ub->enc);
+
+  if (ub->segs) {
+    for (size_t i = 0; i < n && !utfbuf_truncated(ub); i++) {
+      const uint32_t u32 = (uint8_t)str[i];
+      write_utf_internal(ub, &u32, 1, ub->enc);
+    }
+    return UTF_ERROR_SUCCESS;
+  }
+
+  if (!ub->pos) {
+    // Counting buffer (or not even room for the terminator).
+    ub->overflow += n * width;
+    return UTF_ERROR_SUCCESS;
+  }
+
+  // Write as much as fits over the old terminator, then terminate.
+  const size_t fit = min_zu(n, ub_bytes_remaining(ub) / width);
+  uint8_t *out = ub->start + ub->pos - width;
+
+  if (width == 1) {
+    memcpy(out, str, fit);
+  } else if (width == 2) {
+    for (size_t i = 0; i < fit; i++) {
+      const uint16_t u16 = (uint8_t)str[i];
+      memcpy(out + 2*i, &u16, 2);
+    }
+  } else {
+    for (size_t i = 0; i < fit; i++) {
+      const uint32_t u32 = (uint8_t)str[i];
+      memcpy(out + 4*i, &u32, 4);
+    }
+  }
+
+  memset(out + fit * width, 0x0, width);
+  ub->pos += fit * width;
+  ub->overflow += (n - fit) * width;
+  return UTF_ERROR_SUCCESS;
+}
+
 typedef enum {
   SURROGATE_NONE = 0,
   SURROGATE_HIGH = 1,
@@ -294,21 +498,19 @@ utf_error_t utfbuf_write_utf16(utfbuf_t *ub, uint16_t cu)
     ub->in.count = 1 + !!surrogate;
     ub->in.enc = UTF_16;
 
-    if (!surrogate) {
-      ub_write_codepoint(ub);
-    }
+    if (!surrogate)
+      return ub_write_codepoint(ub);
 
     return UTF_ERROR_SUCCESS;
   }
 
-  if (surrogate != SURROGATE_LOW) {
+  if (ub->in.enc != UTF_16 || surrogate != SURROGATE_LOW) {
     ub->in = (ub_inbuf_t){ 0 };
     return UTF_ERROR_INVALID_ARGUMENT;
   }
 
   ub->in.u16[1] = cu;
-  ub_write_codepoint(ub);
-  return UTF_ERROR_SUCCESS;
+  return ub_write_codepoint(ub);
 }
 
 utf_error_t utfbuf_write_utf32(utfbuf_t *ub, uint32_t ch)
@@ -318,13 +520,204 @@ utf_error_t utfbuf_write_utf32(utfbuf_t *ub, uint32_t ch)
     return UTF_ERROR_INVALID_ARGUMENT;
   }
 
+  if (ch > 0x10FFFF || (ch >= 0xD800 && ch <= 0xDFFF)) {
+    // Not a Unicode scalar value.
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+
   ub->in.enc = UTF_32;
   ub->in.u32[0] = ch;
-  ub_write_codepoint(ub);
+  ub->in.count = 1;
+  return ub_write_codepoint(ub);
+}
+
+utf_error_t utfbuf_write_legacy(utfbuf_t *ub, uint8_t byte, utf_enc_t enc)
+{
+  if (!utf_is_legacy(enc) || (ub->in.enc && ub->in.enc != enc)) {
+    // Not a legacy encoding, or a mid-codepoint encoding switch.
+    ub->in = (ub_inbuf_t){ 0 };
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+
+  UTF_RASSERT(ub->in.count < 4);
+  ub->in.enc = enc;
+  ub->in.u8[ub->in.count++] = byte;
+
+  uint32_t cp;
+  const int n = utf_legacy_decode(enc, ub->in.u8, ub->in.count, &cp);
+  if (n < 0) {
+    ub->in = (ub_inbuf_t){ 0 };
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+  if (!n) {
+    // Wait for the rest of the sequence.
+    return UTF_ERROR_SUCCESS;
+  }
+
+  return ub_write_codepoint(ub);
+}
+
+// Write the run of ASCII code units at the start of [p, p+len) in
+// bulk, testing a vector of them at a time. Returns the number of
+// bytes consumed. Must not be called mid-codepoint.
+static size_t ub_write_ascii_run(utfbuf_t *ub,
+    const uint8_t *p, size_t len, utf_enc_t enc)
+{
+  const uint8_t width = utf_bytes(enc);
+  uint8_t tmp[UTF_SIMD_WIDTH];
+  size_t i = 0;
+
+  while (i + UTF_SIMD_WIDTH * width <= len) {
+    const uint8_t *b = utf_simd_narrow(p + i, enc, tmp);
+    const uint32_t high = utf_simd_high_mask(b);
+    const size_t run = high ? utf_simd_ctz(high) : UTF_SIMD_WIDTH;
+    utfbuf_write_ascii(ub, (const char *)b, run);
+    i += run * width;
+    if (run < UTF_SIMD_WIDTH || utfbuf_truncated(ub))
+      return i;
+  }
+
+  // Less than a vector left: narrow it a unit at a time.
+  size_t n = 0;
+  for (; i < len; i += width, n++) {
+    const uint32_t unit = utf_load_unit(p + i, enc);
+    if (unit >= 0x80)
+      break;
+    tmp[n] = unit;
+  }
+  utfbuf_write_ascii(ub, (const char *)tmp, n);
+  return i;
+}
+
+// Legacy text: ASCII runs between characters are copied in bulk,
+// everything else goes a byte at a time through utfbuf_write_legacy.
+static utf_error_t ub_write_legacy_string(utfbuf_t *ub,
+    const uint8_t *p, size_t len, utf_enc_t enc)
+{
+  size_t i = 0;
+
+  while (i < len) {
+    if (!ub->in.enc) {
+      const size_t run = ub_write_ascii_run(ub, p + i, len - i, enc);
+      if (run) {
+        i += run;
+        if (utfbuf_truncated(ub))
+          return UTF_ERROR_SUCCESS;
+        continue;
+      }
+    }
+
+    const utf_error_t err = utfbuf_write_legacy(ub, p[i++], enc);
+    if (err)
+      return err;
+
+    if (utfbuf_truncated(ub))
+      return UTF_ERROR_SUCCESS;
+  }
+
+  return UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utfbuf_write(utfbuf_t *ub,
+    const void *mem, size_t len, utf_enc_t enc)
+{
+  if (utf_is_legacy(enc))
+    return ub_write_legacy_string(ub, mem, len, enc);
+
+  switch (enc) {
+  case UTF_8:
+  case UTF_16:
+  case UTF_32:
+    break;
+  default:
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+
+  const uint8_t width = utf_bytes(enc);
+  if (len % width)
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  const uint8_t *p = mem;
+  utf_error_t err;
+  size_t i = 0;
+
+  while (i < len) {
+    if (ub->translit && !ub->in.enc) {
+      // Transliteration leaves ASCII as it is, so runs of it are
+      // copied in bulk.
+      const size_t run = ub_write_ascii_run(ub, p + i, len - i, enc);
+      if (run) {
+        i += run;
+        if (utfbuf_truncated(ub))
+          return UTF_ERROR_SUCCESS;
+        continue;
+      }
+    }
+
+    switch (enc) {
+      case UTF_8:
+        err = utfbuf_write_utf8(ub, p[i]);
+        break;
+      case UTF_16: {
+        uint16_t cu;
+        memcpy(&cu, p + i, sizeof(cu));
+        err = utfbuf_write_utf16(ub, cu);
+        break;
+      }
+      default: {
+        uint32_t ch;
+        memcpy(&ch, p + i, sizeof(ch));
+        err = utfbuf_write_utf32(ub, ch);
+        break;
+      }
+    }
+    i += width;
+
+    if (err)
+      return err;
+
+    if (utfbuf_truncated(ub))
+      return UTF_ERROR_SUCCESS;
+  }
+
   return UTF_ERROR_SUCCESS;
 }
 
+void utfbuf_set_translit(utfbuf_t *ub, bool on)
+{
+  ub->translit = on;
+}
+
 size_t utfbuf_overflow(const utfbuf_t *ub)
 {
   return ub->overflow;
 }
+
+bool utfbuf_truncated(const utfbuf_t *ub)
+{
+  return !ub_is_counting(ub) && ub->overflow;
+}
+
+size_t utfbuf_length(const utfbuf_t *ub)
+{
+  if (ub->segs)
+    return ub->seg_base + ub->pos;
+
+  const uint8_t width = utf_bytes(ub->enc);
+  return ub->pos < width ? 0 : ub->pos - width;
+}
+
+struct iovec *utfbuf_finish_segments(utfbuf_t *ub, size_t *n_segs)
+{
+  if (!ub->segs) {
+    *n_segs = 0;
+    return NULL;
+  }
+
+  ub->segs[ub->seg].iov_len = ub->pos;
+
+  // Trailing segments which were never reached are not part of the
+  // output; an empty current segment is dropped as well.
+  *n_segs = ub->seg + !!ub->pos;
+  return ub->segs;
+}
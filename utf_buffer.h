@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 #define UTFBUF_DEFINE_LOCAL(name, size, enc)\
   uint8_t name##_storage[size];\
@@ -21,6 +22,12 @@ typedef enum {
   UTF_8  = 1,
   UTF_16 = 2, // LE
   UTF_32 = 3, // LE
+
+  // Legacy CJK multi-byte encodings; see utf_legacy.h.
+  UTF_SHIFT_JIS = 4,
+  UTF_EUC_KR = 5,
+  UTF_GB18030 = 6,
+  UTF_BIG5 = 7,
 } utf_enc_t;
 
 static inline const char *utf_enc_stringify(utf_enc_t enc)
@@ -31,29 +38,86 @@ static inline const char *utf_enc_stringify(utf_enc_t enc)
     C(UTF_8)
     C(UTF_16)
     C(UTF_32)
+    C(UTF_SHIFT_JIS)
+    C(UTF_EUC_KR)
+    C(UTF_GB18030)
+    C(UTF_BIG5)
 #undef C
   }
 }
 
+// Size of a code unit. The legacy encodings are byte-oriented.
 static inline uint8_t utf_bytes(utf_enc_t enc)
 {
-  return 1 << (enc - 1);
+  return enc <= UTF_32 ? 1 << (enc - 1) : 1;
 }
 
 typedef struct utfbuf utfbuf_t;
 
+struct iovec;
+
 utf_error_t utfbuf_init(utfbuf_t *ub,
     void *mem, size_t mem_size, utf_enc_t encoding);
 
+// Flags for utfbuf_init_segmented.
+#define UTFBUF_SEG_SPLIT 0x1 // Allow codepoints to straddle segments.
+
+// Segmented output: write through the caller's segments in order,
+// moving to the next segment when a codepoint does not fit in the
+// current one (or, with UTFBUF_SEG_SPLIT, when the current one is
+// full). Each iov_len gives a segment's capacity on entry. No null
+// terminator is written. Once the segments are exhausted, everything
+// further is counted as overflow, so the output is always a prefix
+// of the input.
+utf_error_t utfbuf_init_segmented(utfbuf_t *ub,
+    struct iovec *segs, size_t n_segs, utf_enc_t encoding,
+    unsigned flags);
+
+// Finish segmented output. Rewrites each used segment's iov_len to
+// the number of bytes written into it and returns the segment array,
+// ready for writev(), with the number of segments used in *n_segs.
+struct iovec *utfbuf_finish_segments(utfbuf_t *ub, size_t *n_segs);
+
 utf_error_t utfbuf_write_utf8(utfbuf_t *ub, uint8_t code_unit);
 utf_error_t utfbuf_write_utf16(utfbuf_t *ub, uint16_t code_unit);
 utf_error_t utfbuf_write_utf32(utfbuf_t *ub, uint32_t code_unit);
 
+// Write one byte of a legacy encoding (see utf_legacy.h). As with
+// UTF-8, a multi-byte character is held back until it is complete, so
+// the text may be fed in arbitrary chunks. A character which has no
+// mapping in the buffer's encoding is UTF_ERROR_INVALID_ARGUMENT.
+utf_error_t utfbuf_write_legacy(utfbuf_t *ub, uint8_t byte, utf_enc_t enc);
+
 utf_error_t utfbuf_write_utf8_string(utfbuf_t *ub,
     const char *str);
 
+// Write n ASCII characters. ASCII is the same codepoint in every
+// encoding, so this is a straight copy (or widening) into the buffer
+// with no decoding. As much as fits is written; the rest is counted
+// as overflow.
+utf_error_t utfbuf_write_ascii(utfbuf_t *ub, const char *str, size_t n);
+
+// Write len bytes of enc-encoded text from mem. Like
+// utfbuf_write_utf8_string, this stops early once a real
+// (non-counting) buffer has overflowed.
+utf_error_t utfbuf_write(utfbuf_t *ub,
+    const void *mem, size_t len, utf_enc_t enc);
+
+// Transliterate to ASCII as text is written (see utf_translit.h):
+// "Ærøskøbing" is written as "AEroskobing". Characters with no ASCII
+// spelling are written unchanged. Overflow counts the transliterated
+// output, so a counting buffer measures it exactly.
+void utfbuf_set_translit(utfbuf_t *ub, bool on);
+
 size_t utfbuf_overflow(const utfbuf_t *ub);
 
+// True once a real (non-counting) buffer has overflowed. Bulk writers
+// stop at this point so the buffer holds a prefix of their input.
+bool utfbuf_truncated(const utfbuf_t *ub);
+
+// Number of bytes written so far, excluding the null terminator.
+size_t utfbuf_length(const utfbuf_t *ub);
+
 // {{{ opaque
 
 typedef struct {
@@ -78,6 +142,18 @@ struct utfbuf {
 
   // Input buffer.
   ub_inbuf_t in;
+
+  // Write the ASCII transliteration of each codepoint.
+  bool translit;
+
+  // Segmented output; segs is NULL for a contiguous buffer. In
+  // segmented mode start/size/pos describe the current segment and
+  // seg_base counts the bytes in the segments before it.
+  struct iovec *segs;
+  size_t n_segs;
+  size_t seg;
+  size_t seg_base;
+  unsigned seg_flags;
 };
 
 // }}}
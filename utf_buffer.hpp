@@ -0,0 +1,368 @@
+#pragma once
+
+// Header-only C++17 layer over utf_buffer.h: compile-time transcoding
+// of string literals, and a utfbuf_t wrapper which takes the standard
+// string views (and, in C++20, spans) directly, picking the source
+// encoding from the character type at compile time.
+
+extern "C" {
+#include "utf_buffer.h"
+}
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#define UTF_HAVE_SPAN 1
+#endif
+#endif
+
+namespace utf {
+
+// {{{ encodings
+
+template <typename CharT>
+struct encoding_of {};
+
+template <>
+struct encoding_of<char> : std::integral_constant<utf_enc_t, UTF_8> {};
+#if defined(__cpp_char8_t)
+template <>
+struct encoding_of<char8_t> : std::integral_constant<utf_enc_t, UTF_8> {};
+#endif
+template <>
+struct encoding_of<char16_t> : std::integral_constant<utf_enc_t, UTF_16> {};
+template <>
+struct encoding_of<char32_t> : std::integral_constant<utf_enc_t, UTF_32> {};
+template <>
+struct encoding_of<wchar_t> : std::integral_constant<utf_enc_t,
+    sizeof(wchar_t) == 2 ? UTF_16 : UTF_32> {};
+
+template <typename CharT>
+inline constexpr utf_enc_t encoding_of_v =
+    encoding_of<std::remove_cv_t<CharT>>::value;
+
+// Code unit type used for output in each encoding.
+template <utf_enc_t Enc> struct char_type_of;
+template <> struct char_type_of<UTF_8> { using type = char; };
+template <> struct char_type_of<UTF_16> { using type = char16_t; };
+template <> struct char_type_of<UTF_32> { using type = char32_t; };
+
+template <utf_enc_t Enc>
+using char_type_t = typename char_type_of<Enc>::type;
+
+// }}}
+
+// {{{ constexpr transcoding
+
+namespace detail {
+
+// Compile-time counterparts of utf_decode/utf_encode (utf_codec.h).
+// Invalid input is not a constant expression, so a bad literal fails
+// to compile.
+struct invalid_literal {};
+
+template <typename CharT>
+constexpr char32_t decode(const CharT *p, std::size_t len, std::size_t &i)
+{
+  constexpr utf_enc_t enc = encoding_of_v<CharT>;
+  char32_t cp = 0;
+
+  if constexpr (enc == UTF_8) {
+    const auto b0 = static_cast<unsigned char>(p[i++]);
+    std::size_t n = 0;
+    char32_t min = 0;
+    if (b0 < 0x80) {
+      return b0;
+    } else if ((b0 & 0xe0) == 0xc0) {
+      n = 1; cp = b0 & 0x1f; min = 0x80;
+    } else if ((b0 & 0xf0) == 0xe0) {
+      n = 2; cp = b0 & 0x0f; min = 0x800;
+    } else if ((b0 & 0xf8) == 0xf0) {
+      n = 3; cp = b0 & 0x07; min = 0x10000;
+    } else {
+      throw invalid_literal{};
+    }
+    for (; n; n--) {
+      if (i >= len || (static_cast<unsigned char>(p[i]) & 0xc0) != 0x80)
+        throw invalid_literal{};
+      cp = (cp << 6) | (static_cast<unsigned char>(p[i++]) & 0x3f);
+    }
+    if (cp < min)
+      throw invalid_literal{};
+  } else if constexpr (enc == UTF_16) {
+    cp = static_cast<char16_t>(p[i++]);
+    if (cp >= 0xDC00 && cp <= 0xDFFF)
+      throw invalid_literal{};
+    if (cp >= 0xD800 && cp <= 0xDBFF) {
+      const char32_t lo = i < len ? static_cast<char16_t>(p[i++]) : 0;
+      if (lo < 0xDC00 || lo > 0xDFFF)
+        throw invalid_literal{};
+      cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+    }
+  } else {
+    cp = static_cast<char32_t>(p[i++]);
+  }
+
+  if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    throw invalid_literal{};
+  return cp;
+}
+
+template <utf_enc_t Enc>
+constexpr std::size_t encode(char32_t cp, char_type_t<Enc> *out)
+{
+  using T = char_type_t<Enc>;
+
+  if constexpr (Enc == UTF_8) {
+    if (cp < 0x80) {
+      out[0] = static_cast<T>(cp);
+      return 1;
+    } else if (cp < 0x800) {
+      out[0] = static_cast<T>(0xc0 | (cp >> 6));
+      out[1] = static_cast<T>(0x80 | (cp & 0x3f));
+      return 2;
+    } else if (cp < 0x10000) {
+      out[0] = static_cast<T>(0xe0 | (cp >> 12));
+      out[1] = static_cast<T>(0x80 | ((cp >> 6) & 0x3f));
+      out[2] = static_cast<T>(0x80 | (cp & 0x3f));
+      return 3;
+    }
+    out[0] = static_cast<T>(0xf0 | (cp >> 18));
+    out[1] = static_cast<T>(0x80 | ((cp >> 12) & 0x3f));
+    out[2] = static_cast<T>(0x80 | ((cp >> 6) & 0x3f));
+    out[3] = static_cast<T>(0x80 | (cp & 0x3f));
+    return 4;
+  } else if constexpr (Enc == UTF_16) {
+    if (cp < 0x10000) {
+      out[0] = static_cast<T>(cp);
+      return 1;
+    }
+    cp -= 0x10000;
+    out[0] = static_cast<T>(0xD800 | (cp >> 10));
+    out[1] = static_cast<T>(0xDC00 | (cp & 0x3ff));
+    return 2;
+  } else {
+    out[0] = cp;
+    return 1;
+  }
+}
+
+// Most output code units one input code unit can produce.
+template <utf_enc_t From, utf_enc_t To>
+constexpr std::size_t expansion()
+{
+  if (To == UTF_8)
+    return From == UTF_8 ? 1 : From == UTF_16 ? 3 : 4;
+  if (To == UTF_16 && From == UTF_32)
+    return 2; // a surrogate pair
+  return 1;
+}
+
+template <utf_enc_t To, typename CharT>
+constexpr std::size_t transcoded_length(const CharT *p, std::size_t len)
+{
+  char_type_t<To> tmp[4] = {};
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < len;)
+    n += encode<To>(decode(p, len, i), tmp);
+  return n;
+}
+
+} // namespace detail
+
+// Fixed-capacity, null-terminated string produced at compile time.
+template <typename CharT, std::size_t Capacity>
+struct static_string {
+  std::array<CharT, Capacity + 1> buf{};
+  std::size_t len = 0;
+
+  constexpr const CharT *data() const { return buf.data(); }
+  constexpr const CharT *c_str() const { return buf.data(); }
+  constexpr std::size_t size() const { return len; }
+  constexpr std::basic_string_view<CharT> view() const
+  {
+    return { buf.data(), len };
+  }
+  constexpr operator std::basic_string_view<CharT>() const { return view(); }
+};
+
+// Transcode a string literal (without its terminator) to To:
+//
+//   constexpr auto greeting = utf::transcode<UTF_16>("héllo");
+//
+// The result's capacity is a bound derived from the literal's length;
+// size() is exact.
+template <utf_enc_t To, typename CharT, std::size_t N>
+constexpr auto transcode(const CharT (&lit)[N])
+{
+  constexpr std::size_t cap =
+      (N - 1) * detail::expansion<encoding_of_v<CharT>, To>();
+  static_string<char_type_t<To>, cap> out{};
+
+  for (std::size_t i = 0; i < N - 1;)
+    out.len += detail::encode<To>(detail::decode(lit, N - 1, i),
+        out.buf.data() + out.len);
+  return out;
+}
+
+#if __cplusplus >= 202002L
+// Literal wrapper usable as a template argument, for exactly sized
+// output.
+template <typename CharT, std::size_t N>
+struct fixed_string {
+  CharT chars[N] = {};
+
+  constexpr fixed_string(const CharT (&lit)[N])
+  {
+    for (std::size_t i = 0; i < N; i++)
+      chars[i] = lit[i];
+  }
+};
+
+// A null-terminated std::array holding exactly the transcoded literal:
+//
+//   constexpr auto &u16 = utf::literal<UTF_16, "héllo">;
+template <utf_enc_t To, fixed_string Lit>
+inline constexpr auto literal = [] {
+  constexpr std::size_t n =
+      detail::transcoded_length<To>(Lit.chars, std::size(Lit.chars) - 1);
+  constexpr auto tmp = transcode<To>(Lit.chars);
+  std::array<char_type_t<To>, n + 1> out{};
+  for (std::size_t i = 0; i < n; i++)
+    out[i] = tmp.buf[i];
+  return out;
+}();
+#endif
+
+// }}}
+
+// {{{ utfbuf
+
+// Non-owning wrapper over a utfbuf_t writing Enc into caller memory.
+// Default-constructed, it counts: overflow() is then the size of the
+// buffer needed for everything written.
+template <utf_enc_t Enc>
+class utfbuf {
+ public:
+  using char_type = char_type_t<Enc>;
+
+  utfbuf() { utfbuf_init(&ub_, nullptr, 0, Enc); }
+
+  utfbuf(char_type *mem, std::size_t count)
+  {
+    utfbuf_init(&ub_, mem, count * sizeof(char_type), Enc);
+  }
+
+  template <std::size_t N>
+  explicit utfbuf(char_type (&mem)[N]) : utfbuf(mem, N) {}
+
+  template <std::size_t N>
+  explicit utfbuf(std::array<char_type, N> &mem) : utfbuf(mem.data(), N) {}
+
+#if UTF_HAVE_SPAN
+  template <std::size_t E>
+  explicit utfbuf(std::span<char_type, E> mem)
+      : utfbuf(mem.data(), mem.size()) {}
+#endif
+
+  utfbuf(const utfbuf &) = delete;
+  utfbuf &operator=(const utfbuf &) = delete;
+
+  // Write text in any encoding, chosen by its character type.
+  utf_error_t write(std::string_view s) { return write_units(s.data(), s.size()); }
+  utf_error_t write(std::u16string_view s) { return write_units(s.data(), s.size()); }
+  utf_error_t write(std::u32string_view s) { return write_units(s.data(), s.size()); }
+#if defined(__cpp_char8_t)
+  utf_error_t write(std::u8string_view s) { return write_units(s.data(), s.size()); }
+#endif
+
+  template <typename CharT, std::size_t N>
+  utf_error_t write(const static_string<CharT, N> &s)
+  {
+    return write_units(s.data(), s.size());
+  }
+
+#if UTF_HAVE_SPAN
+  template <typename CharT, std::size_t E>
+  utf_error_t write(std::span<CharT, E> s)
+  {
+    return write_units(s.data(), s.size());
+  }
+#endif
+
+  // A single codepoint.
+  utf_error_t put(char32_t cp) { return utfbuf_write_utf32(&ub_, cp); }
+
+  std::basic_string_view<char_type> view() const
+  {
+    return { reinterpret_cast<const char_type *>(ub_.start),
+      utfbuf_length(&ub_) / sizeof(char_type) };
+  }
+
+  std::size_t overflow() const { return utfbuf_overflow(&ub_); }
+  bool truncated() const { return utfbuf_truncated(&ub_); }
+
+  utfbuf_t *get() { return &ub_; }
+  const utfbuf_t *get() const { return &ub_; }
+
+ private:
+  template <typename CharT>
+  utf_error_t write_units(const CharT *p, std::size_t n)
+  {
+    constexpr utf_enc_t from = encoding_of_v<CharT>;
+    static_assert(sizeof(CharT) == utf_unit_bytes(from),
+        "code unit size does not match its encoding");
+
+    if constexpr (from == UTF_8) {
+      // Straight to the byte-at-a-time routine, which stops once a
+      // real buffer is full, as utfbuf_write does.
+      for (std::size_t i = 0; i < n && !truncated(); i++) {
+        if (utf_error_t err = utfbuf_write_utf8(&ub_,
+              static_cast<std::uint8_t>(p[i])))
+          return err;
+      }
+    } else if constexpr (from == UTF_16) {
+      for (std::size_t i = 0; i < n && !truncated(); i++) {
+        if (utf_error_t err = utfbuf_write_utf16(&ub_,
+              static_cast<std::uint16_t>(p[i])))
+          return err;
+      }
+    } else {
+      for (std::size_t i = 0; i < n && !truncated(); i++) {
+        if (utf_error_t err = utfbuf_write_utf32(&ub_,
+              static_cast<std::uint32_t>(p[i])))
+          return err;
+      }
+    }
+    return UTF_ERROR_SUCCESS;
+  }
+
+  static constexpr std::size_t utf_unit_bytes(utf_enc_t enc)
+  {
+    return enc == UTF_8 ? 1 : enc == UTF_16 ? 2 : 4;
+  }
+
+  utfbuf_t ub_;
+};
+
+// Size in bytes of the buffer (including terminator) needed to hold s
+// in Enc.
+template <utf_enc_t Enc, typename S>
+std::size_t measure(const S &s)
+{
+  utfbuf<Enc> counter;
+  counter.write(s);
+  return counter.overflow();
+}
+
+// }}}
+
+} // namespace utf
+
+// vim: foldmethod=marker
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Stateless single-codepoint decode/encode over raw memory. These are
+// the building blocks for the (ptr, len, enc) APIs, which operate on
+// borrowed memory rather than through a utfbuf_t. All lengths are in
+// bytes.
+
+static inline uint16_t utf_load16(const uint8_t *p)
+{
+  uint16_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+static inline uint32_t utf_load32(const uint8_t *p)
+{
+  uint32_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+// The code unit at p. Legacy encodings are read a byte at a time.
+static inline uint32_t utf_load_unit(const uint8_t *p, utf_enc_t enc)
+{
+  switch (utf_bytes(enc)) {
+    case 2:
+      return utf_load16(p);
+    case 4:
+      return utf_load32(p);
+    default:
+      return *p;
+  }
+}
+
+static inline int utf_is_scalar(uint32_t cp)
+{
+  return cp <= 0x10FFFF && (cp < 0xD800 || cp > 0xDFFF);
+}
+
+static inline size_t utf8_decode(const uint8_t *p, size_t len,
+    uint32_t *cp)
+{
+  if (!len)
+    return 0;
+
+  const uint8_t b0 = p[0];
+  if (b0 < 0x80) {
+    *cp = b0;
+    return 1;
+  }
+
+  size_t n;
+  uint32_t c, min;
+  if ((b0 & 0xe0) == 0xc0) {
+    n = 2; c = b0 & 0x1f; min = 0x80;
+  } else if ((b0 & 0xf0) == 0xe0) {
+    n = 3; c = b0 & 0x0f; min = 0x800;
+  } else if ((b0 & 0xf8) == 0xf0) {
+    n = 4; c = b0 & 0x07; min = 0x10000;
+  } else {
+    return 0;
+  }
+
+  if (len < n)
+    return 0;
+
+  for (size_t i = 1; i < n; i++) {
+    if ((p[i] & 0xc0) != 0x80)
+      return 0;
+    c = (c << 6) | (p[i] & 0x3f);
+  }
+
+  if (c < min || !utf_is_scalar(c))
+    return 0;
+
+  *cp = c;
+  return n;
+}
+
+static inline size_t utf16_decode(const uint8_t *p, size_t len,
+    uint32_t *cp)
+{
+  if (len < 2)
+    return 0;
+
+  const uint16_t hi = utf_load16(p);
+  if (hi < 0xD800 || hi > 0xDFFF) {
+    *cp = hi;
+    return 2;
+  }
+
+  if (hi > 0xDBFF || len < 4)
+    return 0;
+
+  const uint16_t lo = utf_load16(p + 2);
+  if (lo < 0xDC00 || lo > 0xDFFF)
+    return 0;
+
+  *cp = 0x10000 + ((uint32_t)(hi - 0xD800) << 10) + (lo - 0xDC00);
+  return 4;
+}
+
+static inline size_t utf32_decode(const uint8_t *p, size_t len,
+    uint32_t *cp)
+{
+  if (len < 4)
+    return 0;
+
+  const uint32_t c = utf_load32(p);
+  if (!utf_is_scalar(c))
+    return 0;
+
+  *cp = c;
+  return 4;
+}
+
+// Decode the codepoint at the start of [p, p+len). Returns the number
+// of bytes consumed, or 0 if the input is truncated or malformed.
+static inline size_t utf_decode(const uint8_t *p, size_t len,
+    utf_enc_t enc, uint32_t *cp)
+{
+  switch (enc) {
+    case UTF_8:
+      return utf8_decode(p, len, cp);
+    case UTF_16:
+      return utf16_decode(p, len, cp);
+    case UTF_32:
+      return utf32_decode(p, len, cp);
+    default:
+      return 0;
+  }
+}
+
+// Number of bytes needed to encode cp.
+static inline size_t utf_encoded_size(uint32_t cp, utf_enc_t enc)
+{
+  switch (enc) {
+    case UTF_8:
+      return 1 + (cp >= 0x80) + (cp >= 0x800) + (cp >= 0x10000);
+    case UTF_16:
+      return cp >= 0x10000 ? 4 : 2;
+    case UTF_32:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+// Encode cp into out, returning the number of bytes written. cp must
+// be a Unicode scalar value.
+static inline size_t utf_encode(uint32_t cp, utf_enc_t enc,
+    uint8_t out[4])
+{
+  switch (enc) {
+    case UTF_8:
+      if (cp < 0x80) {
+        out[0] = cp;
+        return 1;
+      }
+      if (cp < 0x800) {
+        out[0] = 0xc0 | (cp >> 6);
+        out[1] = 0x80 | (cp & 0x3f);
+        return 2;
+      }
+      if (cp < 0x10000) {
+        out[0] = 0xe0 | (cp >> 12);
+        out[1] = 0x80 | ((cp >> 6) & 0x3f);
+        out[2] = 0x80 | (cp & 0x3f);
+        return 3;
+      }
+      out[0] = 0xf0 | (cp >> 18);
+      out[1] = 0x80 | ((cp >> 12) & 0x3f);
+      out[2] = 0x80 | ((cp >> 6) & 0x3f);
+      out[3] = 0x80 | (cp & 0x3f);
+      return 4;
+    case UTF_16: {
+      uint16_t u16[2];
+      if (cp < 0x10000) {
+        u16[0] = cp;
+        memcpy(out, u16, 2);
+        return 2;
+      }
+      cp -= 0x10000;
+      u16[0] = 0xD800 | (cp >> 10);
+      u16[1] = 0xDC00 | (cp & 0x3ff);
+      memcpy(out, u16, 4);
+      return 4;
+    }
+    case UTF_32:
+      memcpy(out, &cp, 4);
+      return 4;
+    default:
+      return 0;
+  }
+}
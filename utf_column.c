@@ -0,0 +1,188 @@
+#include "utf_column.h"
+#include "utf_codec.h"
+#include "utf_simd.h"
+
+#include <string.h>
+
+// Output cursor: bytes past size are counted but not stored.
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t pos;
+} col_out_t;
+
+static inline void col_put(col_out_t *out, const uint8_t *p, size_t n)
+{
+  if (out->pos + n <= out->size)
+    memcpy(out->data + out->pos, p, n);
+  out->pos += n;
+}
+
+// Copy or widen n ASCII bytes.
+static inline void col_put_ascii(col_out_t *out, const uint8_t *p,
+    size_t n, unsigned width)
+{
+  size_t i = 0;
+
+  if (out->pos + n * width <= out->size) {
+    uint8_t *dst = out->data + out->pos;
+    for (; i + UTF_SIMD_WIDTH <= n; i += UTF_SIMD_WIDTH)
+      utf_simd_widen(p + i, dst + i * width, width);
+    out->pos += i * width;
+  }
+
+  for (; i < n; i++) {
+    uint8_t unit[4];
+    const size_t k = utf_encode(p[i], width == 1 ? UTF_8 :
+        width == 2 ? UTF_16 : UTF_32, unit);
+    col_put(out, unit, k);
+  }
+}
+
+// True if every byte of [p, p+n) is ASCII. The masks of each vector
+// are or-ed together, so there is no branch per vector.
+static bool col_is_ascii(const uint8_t *p, size_t n)
+{
+  uint32_t high = 0;
+  size_t i = 0;
+
+  for (; i + UTF_SIMD_WIDTH <= n; i += UTF_SIMD_WIDTH)
+    high |= utf_simd_high_mask(p + i);
+  for (; i < n; i++)
+    high |= p[i] & 0x80;
+
+  return !high;
+}
+
+// All rows ASCII UTF-8 with increasing offsets: every row is valid and
+// each output offset is a scaled input offset.
+static bool col_ascii_fast_path(const utf_column_t *in, utf_enc_t enc,
+    uint32_t *offsets, col_out_t *out, uint8_t *errors)
+{
+  const uint32_t *off = in->offsets;
+  const size_t count = in->count;
+  const unsigned width = utf_bytes(enc);
+
+  bool sorted = true;
+  for (size_t r = 0; r < count; r++)
+    sorted &= off[r] <= off[r + 1];
+  if (!sorted)
+    return false;
+
+  const uint8_t *src = (const uint8_t *)in->data + off[0];
+  const size_t n = off[count] - off[0];
+  if ((uint64_t)n * width > UINT32_MAX || !col_is_ascii(src, n))
+    return false;
+
+  if (offsets) {
+    for (size_t r = 0; r <= count; r++)
+      offsets[r] = (off[r] - off[0]) * width;
+  }
+  col_put_ascii(out, src, n, width);
+  if (errors)
+    memset(errors, 0, (count + 7) / 8);
+  return true;
+}
+
+// Transcode one row. Returns false if it is malformed.
+static inline bool col_row(const uint8_t *p, size_t len, utf_enc_t from,
+    utf_enc_t to, col_out_t *out)
+{
+  const unsigned width = utf_bytes(to);
+  size_t i = 0;
+
+  if (len % utf_bytes(from))
+    return false;
+
+  while (i < len) {
+    if (from == UTF_8) {
+      size_t run = i;
+      while (run + UTF_SIMD_WIDTH <= len && !utf_simd_high_mask(p + run))
+        run += UTF_SIMD_WIDTH;
+      while (run < len && p[run] < 0x80)
+        run++;
+      if (run > i) {
+        col_put_ascii(out, p + i, run - i, width);
+        i = run;
+        continue;
+      }
+    }
+
+    uint32_t cp;
+    const size_t k = utf_decode(p + i, len - i, from, &cp);
+    if (!k)
+      return false;
+
+    uint8_t unit[4];
+    col_put(out, unit, utf_encode(cp, to, unit));
+    i += k;
+  }
+
+  return true;
+}
+
+utf_error_t utf_column_transcode(const utf_column_t *in, utf_enc_t enc,
+    uint32_t *offsets, void *data, size_t size, size_t *len,
+    uint8_t *errors)
+{
+  switch (in->enc) {
+  case UTF_8:
+  case UTF_16:
+  case UTF_32:
+    break;
+  default:
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+  switch (enc) {
+  case UTF_8:
+  case UTF_16:
+  case UTF_32:
+    break;
+  default:
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+
+  col_out_t out = { .data = data, .size = data ? size : 0 };
+  utf_error_t err = UTF_ERROR_SUCCESS;
+
+  if (in->enc == UTF_8 &&
+      col_ascii_fast_path(in, enc, offsets, &out, errors)) {
+    *len = out.pos;
+    return UTF_ERROR_SUCCESS;
+  }
+
+  if (errors)
+    memset(errors, 0, (in->count + 7) / 8);
+
+  const uint8_t *src = in->data;
+  for (size_t r = 0; r < in->count; r++) {
+    const uint32_t begin = in->offsets[r];
+    const uint32_t end = in->offsets[r + 1];
+    const size_t row_start = out.pos;
+
+    if (offsets)
+      offsets[r] = (uint32_t)row_start;
+
+    if (end < begin ||
+        !col_row(src + begin, end - begin, in->enc, enc, &out)) {
+      out.pos = row_start;
+      if (errors)
+        errors[r / 8] |= 1u << (r % 8);
+      err = UTF_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (out.pos > UINT32_MAX)
+      return UTF_ERROR_FAILURE;
+  }
+
+  if (offsets)
+    offsets[in->count] = (uint32_t)out.pos;
+  *len = out.pos;
+  return err;
+}
+
+utf_error_t utf_column_validate(const utf_column_t *in, uint8_t *errors)
+{
+  size_t len;
+  return utf_column_transcode(in, in->enc, NULL, NULL, 0, &len, errors);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Batch operations over Arrow-style string columns: row i is the text
+// at data[offsets[i]] up to data[offsets[i+1]], so offsets holds
+// count + 1 entries. Offsets are in bytes, whatever the encoding.
+//
+// A whole column goes through in one pass, without per-row calls. A
+// column of all-ASCII UTF-8 is validated with one vector scan and then
+// copied (or widened) in bulk.
+
+typedef struct {
+  const uint32_t *offsets;
+  const void *data;
+  size_t count;
+  utf_enc_t enc;
+} utf_column_t;
+
+// Transcode every row of in to enc, writing count + 1 offsets (unless
+// offsets is NULL) and the row data. Rows which are malformed, including ones cut off in the
+// middle of a codepoint or with decreasing offsets, come out empty and
+// have their bit set in errors (bit i % 8 of byte i / 8), if it is not
+// NULL.
+//
+// *len receives the total size of the output data. Only the first
+// size bytes are written, so a NULL data with size 0 measures; the
+// offsets always describe the complete output.
+//
+// Returns UTF_ERROR_INVALID_ARGUMENT if any row was invalid, and
+// UTF_ERROR_FAILURE if the output does not fit 32-bit offsets.
+utf_error_t utf_column_transcode(const utf_column_t *in, utf_enc_t enc,
+    uint32_t *offsets, void *data, size_t size, size_t *len,
+    uint8_t *errors);
+
+// Check every row of in without writing any output. Errors are
+// reported as for utf_column_transcode.
+utf_error_t utf_column_validate(const utf_column_t *in, uint8_t *errors);
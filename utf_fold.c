@@ -0,0 +1,251 @@
+#include "utf_fold.h"
+#include "utf_fold_table.h"
+#include "utf_codec.h"
+#include "utf_simd.h"
+#include "minmax.h"
+
+#include <string.h>
+
+size_t utf_cp_fold(uint32_t cp, uint32_t out[3])
+{
+  const uint32_t *row = utf_fold_data[utf_fold_lookup(cp)];
+
+  if (!row[1]) {
+    out[0] = cp + row[0];
+    return 1;
+  }
+
+  out[0] = row[0];
+  out[1] = row[1];
+  out[2] = row[2];
+  return row[2] ? 3 : 2;
+}
+
+static inline bool fold_is_encoding(utf_enc_t enc)
+{
+  return enc == UTF_8 || enc == UTF_16 || enc == UTF_32;
+}
+
+// {{{ hash
+
+// Streaming hash with xxHash64-style mixing, fed 8 bytes at a time.
+// The result depends only on the bytes fed, not on how they were
+// split up between calls.
+
+#define P1 0x9E3779B185EBCA87ull
+#define P2 0xC2B2AE3D27D4EB4Full
+#define P3 0x165667B19E3779F9ull
+#define P4 0x85EBCA77C2B2AE63ull
+#define P5 0x27D4EB2F165667C5ull
+
+typedef struct {
+  uint64_t h;
+  uint64_t len;
+  uint8_t buf[8];
+  size_t n;
+} fold_hash_t;
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline void hash_word(fold_hash_t *st, const uint8_t *p)
+{
+  uint64_t w;
+  memcpy(&w, p, sizeof(w));
+  st->h ^= rotl64(w * P2, 31) * P1;
+  st->h = rotl64(st->h, 27) * P1 + P4;
+}
+
+static inline void hash_feed(fold_hash_t *st, const uint8_t *p, size_t n)
+{
+  st->len += n;
+
+  if (st->n) {
+    const size_t take = min_zu(8 - st->n, n);
+    memcpy(st->buf + st->n, p, take);
+    st->n += take;
+    p += take;
+    n -= take;
+    if (st->n < 8)
+      return;
+    hash_word(st, st->buf);
+    st->n = 0;
+  }
+
+  for (; n >= 8; p += 8, n -= 8)
+    hash_word(st, p);
+
+  memcpy(st->buf, p, n);
+  st->n = n;
+}
+
+static uint64_t hash_finish(fold_hash_t *st)
+{
+  uint64_t h = st->h + st->len;
+  size_t i = 0;
+
+  if (st->n >= 4) {
+    uint32_t w;
+    memcpy(&w, st->buf, sizeof(w));
+    h ^= w * P1;
+    h = rotl64(h, 23) * P2 + P3;
+    i = 4;
+  }
+  for (; i < st->n; i++) {
+    h ^= st->buf[i] * P5;
+    h = rotl64(h, 11) * P1;
+  }
+
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t utf_hash_folded(const void *mem, size_t len, utf_enc_t enc,
+    uint64_t seed)
+{
+  fold_hash_t st = { .h = seed + P5 };
+  if (!fold_is_encoding(enc))
+    return hash_finish(&st);
+
+  const uint8_t *p = mem;
+  const size_t width = utf_bytes(enc);
+  const size_t block = UTF_SIMD_WIDTH * width;
+  size_t i = 0;
+
+  while (i < len) {
+    if (i + block <= len) {
+      // A block of ASCII folds by lowering A-Z.
+      uint8_t tmp[UTF_SIMD_WIDTH], lower[UTF_SIMD_WIDTH];
+      const uint8_t *b = utf_simd_narrow(p + i, enc, tmp);
+      const uint32_t high = utf_simd_high_mask(b);
+      const size_t run = high ? utf_simd_ctz(high) : UTF_SIMD_WIDTH;
+      if (run) {
+        utf_simd_ascii_lower(b, lower);
+        hash_feed(&st, lower, run);
+        i += run * width;
+        continue;
+      }
+    }
+
+    // Fold and hash codepoints singly up to the next ASCII unit, or to
+    // the end once less than a block is left.
+    do {
+      uint32_t cp, folded[3];
+      size_t k = utf_decode(p + i, len - i, enc, &cp);
+      if (!k) {
+        cp = 0xFFFD;
+        k = min_zu(width, len - i);
+      }
+
+      const size_t n = utf_cp_fold(cp, folded);
+      for (size_t j = 0; j < n; j++) {
+        uint8_t u8[4];
+        hash_feed(&st, u8, utf_encode(folded[j], UTF_8, u8));
+      }
+      i += k;
+    } while (i < len && (i + block > len || utf_load_unit(p + i, enc) >= 0x80));
+  }
+
+  return hash_finish(&st);
+}
+
+// }}}
+
+// {{{ equality
+
+// Folded codepoints of one side, a codepoint at a time.
+typedef struct {
+  const uint8_t *p;
+  size_t len;
+  utf_enc_t enc;
+  size_t i;
+
+  uint32_t pending[3];
+  uint8_t n_pending;
+  uint8_t next_pending;
+} fold_iter_t;
+
+// 1 with the next folded codepoint in *cp, 0 at the end, or -1 on
+// malformed input.
+static inline int fold_next(fold_iter_t *it, uint32_t *cp)
+{
+  if (it->next_pending < it->n_pending) {
+    *cp = it->pending[it->next_pending++];
+    return 1;
+  }
+
+  if (it->i >= it->len)
+    return 0;
+
+  uint32_t c;
+  const size_t k = utf_decode(it->p + it->i, it->len - it->i, it->enc, &c);
+  if (!k)
+    return -1;
+  it->i += k;
+
+  it->n_pending = (uint8_t)utf_cp_fold(c, it->pending);
+  it->next_pending = 1;
+  *cp = it->pending[0];
+  return 1;
+}
+
+// Number of code units at the start of the next vector of it which
+// are ASCII, or 0 if a whole vector is not available.
+static inline size_t fold_ascii_block(const fold_iter_t *it,
+    uint8_t *lower)
+{
+  const size_t width = utf_bytes(it->enc);
+  if (it->next_pending < it->n_pending ||
+      it->i + UTF_SIMD_WIDTH * width > it->len)
+    return 0;
+
+  uint8_t tmp[UTF_SIMD_WIDTH];
+  const uint8_t *b = utf_simd_narrow(it->p + it->i, it->enc, tmp);
+  const uint32_t high = utf_simd_high_mask(b);
+  utf_simd_ascii_lower(b, lower);
+  return high ? utf_simd_ctz(high) : UTF_SIMD_WIDTH;
+}
+
+bool utf_equal_folded(const void *a, size_t alen, utf_enc_t aenc,
+    const void *b, size_t blen, utf_enc_t benc)
+{
+  if (!fold_is_encoding(aenc) || !fold_is_encoding(benc))
+    return false;
+
+  fold_iter_t ia = { .p = a, .len = alen, .enc = aenc };
+  fold_iter_t ib = { .p = b, .len = blen, .enc = benc };
+
+  for (;;) {
+    // Compare the common ASCII prefix of the next vectors in bulk.
+    uint8_t la[UTF_SIMD_WIDTH], lb[UTF_SIMD_WIDTH];
+    const size_t run = min_zu(fold_ascii_block(&ia, la),
+        fold_ascii_block(&ib, lb));
+    if (run) {
+      if (memcmp(la, lb, run))
+        return false;
+      ia.i += run * utf_bytes(aenc);
+      ib.i += run * utf_bytes(benc);
+      continue;
+    }
+
+    uint32_t ca = 0, cb = 0;
+    const int ra = fold_next(&ia, &ca);
+    const int rb = fold_next(&ib, &cb);
+    if (ra < 0 || rb < 0 || ra != rb)
+      return false;
+    if (!ra)
+      return true;
+    if (ca != cb)
+      return false;
+  }
+}
+
+// }}}
+
+// vim: foldmethod=marker
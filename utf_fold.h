@@ -0,0 +1,25 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Caseless matching by Unicode full case folding (CaseFolding.txt,
+// statuses C and F), applied on the fly: no folded copy of the text
+// is ever made. "Straße", "STRASSE" and "strasse" are all equal.
+
+// Fold one codepoint into out, returning the number of codepoints
+// written (1 to 3).
+size_t utf_cp_fold(uint32_t cp, uint32_t out[3]);
+
+// 64-bit non-cryptographic hash of the folded text. The folded
+// codepoints are hashed as UTF-8, so the result is the same whatever
+// the source encoding. Malformed units hash as U+FFFD.
+uint64_t utf_hash_folded(const void *mem, size_t len, utf_enc_t enc,
+    uint64_t seed);
+
+// Equality after folding. Malformed text compares unequal.
+bool utf_equal_folded(const void *a, size_t alen, utf_enc_t aenc,
+    const void *b, size_t blen, utf_enc_t benc);
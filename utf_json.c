@@ -0,0 +1,214 @@
+#include "utf_json.h"
+#include "utf_codec.h"
+#include "utf_simd.h"
+
+#include <stdbool.h>
+
+static bool json_special(uint8_t b)
+{
+  return b < 0x20 || b >= 0x80 || b == '"' || b == '\\';
+}
+
+// Length of the run of plain ASCII at the start of [p, p+len).
+static size_t json_clean_run(const uint8_t *p, size_t len)
+{
+  size_t i = 0;
+
+  for (; i + UTF_SIMD_WIDTH <= len; i += UTF_SIMD_WIDTH) {
+    const uint32_t mask = utf_simd_json_mask(p + i);
+    if (mask)
+      return i + utf_simd_ctz(mask);
+  }
+
+  while (i < len && !json_special(p[i]))
+    i++;
+
+  return i;
+}
+
+static int json_hex_digit(uint8_t c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+static bool json_parse_u16(const uint8_t *p, uint16_t *out)
+{
+  uint16_t cu = 0;
+  for (int i = 0; i < 4; i++) {
+    const int d = json_hex_digit(p[i]);
+    if (d < 0)
+      return false;
+    cu = (cu << 4) | d;
+  }
+
+  *out = cu;
+  return true;
+}
+
+static utf_error_t json_unescape(utfbuf_t *ub, const char *json,
+    size_t len)
+{
+  const uint8_t *p = (const uint8_t *)json;
+  utf_error_t err;
+  size_t i = 0;
+
+  while (i < len && !utfbuf_truncated(ub)) {
+    const size_t run = json_clean_run(p + i, len - i);
+    if (run) {
+      err = utfbuf_write_ascii(ub, json + i, run);
+      if (err)
+        return err;
+      i += run;
+      continue;
+    }
+
+    if (p[i] >= 0x80) {
+      uint32_t cp;
+      const size_t n = utf8_decode(p + i, len - i, &cp);
+      if (!n)
+        return UTF_ERROR_INVALID_ARGUMENT;
+
+      err = utfbuf_write_utf32(ub, cp);
+      if (err)
+        return err;
+      i += n;
+      continue;
+    }
+
+    // Unescaped quotes and control characters are not allowed.
+    if (p[i] != '\\' || i + 1 >= len)
+      return UTF_ERROR_INVALID_ARGUMENT;
+
+    char c;
+    switch (p[i+1]) {
+      case '"':  c = '"'; break;
+      case '\\': c = '\\'; break;
+      case '/':  c = '/'; break;
+      case 'b':  c = '\b'; break;
+      case 'f':  c = '\f'; break;
+      case 'n':  c = '\n'; break;
+      case 'r':  c = '\r'; break;
+      case 't':  c = '\t'; break;
+      case 'u': {
+        uint16_t cu;
+        if (i + 6 > len || !json_parse_u16(p + i + 2, &cu))
+          return UTF_ERROR_INVALID_ARGUMENT;
+
+        // utfbuf_write_utf16 does the surrogate pairing, and
+        // rejects unpaired surrogates.
+        err = utfbuf_write_utf16(ub, cu);
+        if (err)
+          return err;
+        i += 6;
+        continue;
+      }
+      default:
+        return UTF_ERROR_INVALID_ARGUMENT;
+    }
+
+    err = utfbuf_write_ascii(ub, &c, 1);
+    if (err)
+      return err;
+    i += 2;
+  }
+
+  // A dangling high surrogate is an error too.
+  return ub->in.enc ? UTF_ERROR_INVALID_ARGUMENT : UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utfbuf_write_json_unescaped(utfbuf_t *ub,
+    const char *json, size_t len)
+{
+  const utf_error_t err = json_unescape(ub, json, len);
+  if (err) {
+    // Drop any half of a surrogate pair, so that it is not left to
+    // pair with whatever the caller writes next.
+    ub->in = (ub_inbuf_t){ 0 };
+  }
+  return err;
+}
+
+static utf_error_t json_write_u_escape(utfbuf_t *ub, uint16_t cu)
+{
+  static const char hex[] = "0123456789abcdef";
+  const char esc[6] = {
+    '\\', 'u',
+    hex[cu >> 12], hex[(cu >> 8) & 0xf],
+    hex[(cu >> 4) & 0xf], hex[cu & 0xf],
+  };
+  return utfbuf_write_ascii(ub, esc, sizeof(esc));
+}
+
+static utf_error_t json_escape_cp(utfbuf_t *ub, uint32_t cp,
+    unsigned flags)
+{
+  if (cp >= 0x80) {
+    if (!(flags & UTF_JSON_ESCAPE_NON_ASCII))
+      return utfbuf_write_utf32(ub, cp);
+
+    if (cp < 0x10000)
+      return json_write_u_escape(ub, cp);
+
+    cp -= 0x10000;
+    const utf_error_t err = json_write_u_escape(ub, 0xD800 | (cp >> 10));
+    return err ? err : json_write_u_escape(ub, 0xDC00 | (cp & 0x3ff));
+  }
+
+  char esc[2] = { '\\', 0 };
+  switch (cp) {
+    case '"':  esc[1] = '"'; break;
+    case '\\': esc[1] = '\\'; break;
+    case '\b': esc[1] = 'b'; break;
+    case '\f': esc[1] = 'f'; break;
+    case '\n': esc[1] = 'n'; break;
+    case '\r': esc[1] = 'r'; break;
+    case '\t': esc[1] = 't'; break;
+    default:
+      if (cp < 0x20)
+        return json_write_u_escape(ub, cp);
+
+      esc[0] = cp;
+      return utfbuf_write_ascii(ub, esc, 1);
+  }
+
+  return utfbuf_write_ascii(ub, esc, 2);
+}
+
+utf_error_t utfbuf_write_json_escaped(utfbuf_t *ub,
+    const void *mem, size_t len, utf_enc_t enc, unsigned flags)
+{
+  const uint8_t *p = mem;
+  utf_error_t err;
+  size_t i = 0;
+
+  while (i < len && !utfbuf_truncated(ub)) {
+    if (enc == UTF_8) {
+      const size_t run = json_clean_run(p + i, len - i);
+      if (run) {
+        err = utfbuf_write_ascii(ub, (const char *)p + i, run);
+        if (err)
+          return err;
+        i += run;
+        continue;
+      }
+    }
+
+    uint32_t cp;
+    const size_t n = utf_decode(p + i, len - i, enc, &cp);
+    if (!n)
+      return UTF_ERROR_INVALID_ARGUMENT;
+
+    err = json_escape_cp(ub, cp, flags);
+    if (err)
+      return err;
+    i += n;
+  }
+
+  return UTF_ERROR_SUCCESS;
+}
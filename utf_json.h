@@ -0,0 +1,22 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stddef.h>
+
+// JSON string bodies (the text between the quotes) to and from any
+// utfbuf_t encoding.
+
+// Flags for utfbuf_write_json_escaped.
+#define UTF_JSON_ESCAPE_NON_ASCII 0x1 // Emit \uXXXX for non-ASCII.
+
+// Decode the JSON string body json[0..len), which must be UTF-8, into
+// ub. \uXXXX escapes (including surrogate pairs) are decoded straight
+// into ub's encoding.
+utf_error_t utfbuf_write_json_unescaped(utfbuf_t *ub,
+    const char *json, size_t len);
+
+// Write enc-encoded text into ub as a JSON string body, escaping '"',
+// '\\' and control characters.
+utf_error_t utfbuf_write_json_escaped(utfbuf_t *ub,
+    const void *mem, size_t len, utf_enc_t enc, unsigned flags);
@@ -0,0 +1,189 @@
+#include "utf_legacy.h"
+#include "utf_legacy_table.h"
+#include "utf_codec.h"
+
+// Double-byte sequences are looked up by pointer, the row-major index
+// of (lead, trail) over leads 81-FE and trails 40-FE. Each encoding
+// has a trie from pointer to codepoint for decoding and one from BMP
+// codepoint back to bytes for encoding; both share identical blocks,
+// so the large unassigned areas cost next to nothing.
+
+static inline uint16_t legacy_single(utf_enc_t enc, uint8_t byte)
+{
+  switch (enc) {
+    case UTF_SHIFT_JIS:
+      return utf_sjis_single[byte - 0x80];
+    case UTF_EUC_KR:
+      return utf_euckr_single[byte - 0x80];
+    case UTF_GB18030:
+      return utf_gb18030_single[byte - 0x80];
+    default:
+      return utf_big5_single[byte - 0x80];
+  }
+}
+
+static inline uint16_t legacy_decode_ptr(utf_enc_t enc, uint32_t ptr)
+{
+  switch (enc) {
+    case UTF_SHIFT_JIS:
+      return utf_sjis_decode_lookup(ptr);
+    case UTF_EUC_KR:
+      return utf_euckr_decode_lookup(ptr);
+    case UTF_GB18030:
+      return utf_gb18030_decode_lookup(ptr);
+    default:
+      return utf_big5_decode_lookup(ptr);
+  }
+}
+
+// A single byte 80-FF, 0x100 + pointer, or 0 if unmapped.
+static inline uint16_t legacy_encode_cp(utf_enc_t enc, uint32_t cp)
+{
+  if (cp >= 0x10000)
+    return 0;
+
+  switch (enc) {
+    case UTF_SHIFT_JIS:
+      return utf_sjis_encode_lookup(cp);
+    case UTF_EUC_KR:
+      return utf_euckr_encode_lookup(cp);
+    case UTF_GB18030:
+      return utf_gb18030_encode_lookup(cp);
+    default:
+      return utf_big5_encode_lookup(cp);
+  }
+}
+
+// {{{ GB18030 four-byte sequences
+
+// Four-byte sequences are numbered by pointer too. Those for the BMP
+// form a few hundred runs of consecutive codepoints, searched by
+// bisection; the supplementary planes follow algorithmically.
+
+#define GB_SUPP_END (UTF_GB18030_SUPP_POINTER + 0x100000)
+
+// Index of the last run starting at or before key.
+static size_t gb_find_range(const uint16_t *starts, uint32_t key)
+{
+  size_t lo = 0, hi = UTF_GB18030_RANGES;
+  while (hi - lo > 1) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (starts[mid] <= key)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static int gb_decode4(const uint8_t *p, size_t n, uint32_t *cp)
+{
+  // p[1] is already known to be 30-39.
+  if (n >= 3 && (p[2] < 0x81 || p[2] == 0xFF))
+    return -1;
+  if (n >= 4 && (p[3] < 0x30 || p[3] > 0x39))
+    return -1;
+  if (n < 4)
+    return 0;
+
+  const uint32_t ptr = (((p[0] - 0x81) * 10 + p[1] - 0x30) * 126 +
+      p[2] - 0x81) * 10 + p[3] - 0x30;
+
+  if (ptr < UTF_GB18030_BMP_POINTERS) {
+    const size_t r = gb_find_range(utf_gb18030_range_ptr, ptr);
+    *cp = utf_gb18030_range_cp[r] + (ptr - utf_gb18030_range_ptr[r]);
+    return 4;
+  }
+  if (ptr >= UTF_GB18030_SUPP_POINTER && ptr < GB_SUPP_END) {
+    *cp = 0x10000 + (ptr - UTF_GB18030_SUPP_POINTER);
+    return 4;
+  }
+  return -1;
+}
+
+static size_t gb_encode4(uint32_t cp, uint8_t out[4])
+{
+  uint32_t ptr;
+  if (cp >= 0x10000) {
+    ptr = UTF_GB18030_SUPP_POINTER + (cp - 0x10000);
+  } else {
+    const size_t r = gb_find_range(utf_gb18030_range_cp, cp);
+    ptr = utf_gb18030_range_ptr[r] + (cp - utf_gb18030_range_cp[r]);
+  }
+
+  out[3] = 0x30 + ptr % 10;
+  ptr /= 10;
+  out[2] = 0x81 + ptr % 126;
+  ptr /= 126;
+  out[1] = 0x30 + ptr % 10;
+  out[0] = 0x81 + ptr / 10;
+  return 4;
+}
+
+// }}}
+
+int utf_legacy_decode(utf_enc_t enc, const uint8_t *p, size_t n,
+    uint32_t *cp)
+{
+  if (!n)
+    return 0;
+
+  const uint8_t lead = p[0];
+  if (lead < 0x80) {
+    *cp = lead;
+    return 1;
+  }
+
+  const uint16_t single = legacy_single(enc, lead);
+  if (single) {
+    *cp = single;
+    return 1;
+  }
+
+  if (lead < UTF_LEGACY_LEAD || lead == 0xFF)
+    return -1;
+  if (n < 2)
+    return 0;
+
+  const uint8_t trail = p[1];
+  if (enc == UTF_GB18030 && trail >= 0x30 && trail <= 0x39)
+    return gb_decode4(p, n, cp);
+  if (trail < UTF_LEGACY_TRAIL || trail == 0xFF)
+    return -1;
+
+  const uint32_t ptr = (lead - UTF_LEGACY_LEAD) * UTF_LEGACY_TRAILS +
+    (trail - UTF_LEGACY_TRAIL);
+  const uint16_t c = legacy_decode_ptr(enc, ptr);
+  if (!c)
+    return -1;
+
+  *cp = c;
+  return 2;
+}
+
+size_t utf_legacy_encode(utf_enc_t enc, uint32_t cp, uint8_t out[4])
+{
+  if (cp < 0x80) {
+    out[0] = cp;
+    return 1;
+  }
+
+  const uint16_t v = legacy_encode_cp(enc, cp);
+  if (v >= 0x100) {
+    const uint32_t ptr = v - 0x100;
+    out[0] = UTF_LEGACY_LEAD + ptr / UTF_LEGACY_TRAILS;
+    out[1] = UTF_LEGACY_TRAIL + ptr % UTF_LEGACY_TRAILS;
+    return 2;
+  }
+  if (v) {
+    out[0] = v;
+    return 1;
+  }
+
+  // Everything else has a four-byte sequence in GB18030.
+  if (enc == UTF_GB18030 && utf_is_scalar(cp))
+    return gb_encode4(cp, out);
+  return 0;
+}
+
+// vim: foldmethod=marker
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Legacy CJK multi-byte encodings, as utfbuf_t sources and targets:
+//
+//   UTF_SHIFT_JIS  Windows code page 932
+//   UTF_EUC_KR     Windows code page 949 (Unified Hangul Code)
+//   UTF_GB18030    GB18030, covering all of Unicode
+//   UTF_BIG5       Windows code page 950
+//
+// Bytes 00-7F are ASCII in all of them. Trail bytes may also fall in
+// that range, so ASCII can only be taken at a character boundary.
+// Mappings come from the index files in ucd/.
+
+static inline bool utf_is_legacy(utf_enc_t enc)
+{
+  return enc >= UTF_SHIFT_JIS && enc <= UTF_BIG5;
+}
+
+// Decode the character at the start of the n bytes at p. Returns its
+// length in bytes (1, 2 or 4), 0 if the n bytes are a valid prefix of
+// a longer sequence, or -1 if they are malformed or unmapped.
+int utf_legacy_decode(utf_enc_t enc, const uint8_t *p, size_t n,
+    uint32_t *cp);
+
+// Encode cp into out, returning the number of bytes written, or 0 if
+// enc has no mapping for cp.
+size_t utf_legacy_encode(utf_enc_t enc, uint32_t cp, uint8_t out[4]);
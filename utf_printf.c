@@ -0,0 +1,355 @@
+#include "utf_printf.h"
+#include "utf_codec.h"
+#include "utf_legacy.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  char flags[8];
+  bool left;
+  int width;   // -1 if absent
+  int prec;    // -1 if absent
+  bool overflow; // width or precision does not fit in an int
+  char length[3];
+  char conv;
+} pf_spec_t;
+
+// Write UTF-8 text, taking the no-decode path when it is ASCII.
+static utf_error_t pf_write_utf8(utfbuf_t *ub, const char *s, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    if ((uint8_t)s[i] >= 0x80)
+      return utfbuf_write(ub, s, n, UTF_8);
+  }
+
+  return utfbuf_write_ascii(ub, s, n);
+}
+
+static utf_error_t pf_pad(utfbuf_t *ub, size_t n)
+{
+  static const char spaces[] = "                ";
+  while (n) {
+    const size_t k = n < sizeof(spaces) - 1 ? n : sizeof(spaces) - 1;
+    const utf_error_t err = utfbuf_write_ascii(ub, spaces, k);
+    if (err)
+      return err;
+    n -= k;
+  }
+
+  return UTF_ERROR_SUCCESS;
+}
+
+static size_t pf_unit_strlen(const void *mem, utf_enc_t enc)
+{
+  size_t n = 0;
+
+  switch (enc) {
+    case UTF_16:
+      for (const uint16_t *p = mem; p[n]; n++);
+      return 2 * n;
+    case UTF_32:
+      for (const uint32_t *p = mem; p[n]; n++);
+      return 4 * n;
+    default:
+      return strlen(mem);
+  }
+}
+
+static utf_error_t pf_write_str(utfbuf_t *ub, const pf_spec_t *spec,
+    const void *mem, size_t len, utf_enc_t enc)
+{
+  if (spec->width < 0 && spec->prec < 0)
+    return utfbuf_write(ub, mem, len, enc);
+
+  // Width and precision count codepoints: walk the argument to find
+  // how much of it to write and how wide that is.
+  const size_t max_cps = spec->prec < 0 ? SIZE_MAX : (size_t)spec->prec;
+  const uint8_t *p = mem;
+  size_t bytes = 0, cps = 0;
+
+  while (bytes < len && cps < max_cps) {
+    uint32_t cp;
+    const int n = utf_is_legacy(enc)
+      ? utf_legacy_decode(enc, p + bytes, len - bytes, &cp)
+      : (int)utf_decode(p + bytes, len - bytes, enc, &cp);
+    if (n <= 0)
+      return UTF_ERROR_INVALID_ARGUMENT;
+    bytes += n;
+    cps++;
+  }
+
+  const size_t pad = (spec->width > 0 && (size_t)spec->width > cps)
+    ? spec->width - cps : 0;
+  utf_error_t err;
+
+  if (!spec->left && (err = pf_pad(ub, pad)))
+    return err;
+
+  if ((err = utfbuf_write(ub, mem, bytes, enc)))
+    return err;
+
+  return spec->left ? pf_pad(ub, pad) : UTF_ERROR_SUCCESS;
+}
+
+static utf_error_t pf_write_char(utfbuf_t *ub, const pf_spec_t *spec,
+    uint32_t cp)
+{
+  const size_t pad = spec->width > 1 ? spec->width - 1 : 0;
+  utf_error_t err;
+
+  if (!spec->left && (err = pf_pad(ub, pad)))
+    return err;
+
+  if ((err = utfbuf_write_utf32(ub, cp)))
+    return err;
+
+  return spec->left ? pf_pad(ub, pad) : UTF_ERROR_SUCCESS;
+}
+
+// Format one numeric argument with the C library. The result is
+// plain text, so it can go straight into the buffer.
+static utf_error_t pf_snprintf(utfbuf_t *ub, const char *spec, ...)
+{
+  char local[128];
+  va_list va, va2;
+
+  va_start(va, spec);
+  va_copy(va2, va);
+  const int n = vsnprintf(local, sizeof(local), spec, va);
+  va_end(va);
+
+  utf_error_t err = UTF_ERROR_FAILURE;
+  if (n < 0) {
+    va_end(va2);
+    return err;
+  }
+
+  if ((size_t)n < sizeof(local)) {
+    err = pf_write_utf8(ub, local, n);
+  } else {
+    // Very wide fields or large precisions.
+    char *heap = malloc((size_t)n + 1);
+    if (heap) {
+      vsnprintf(heap, (size_t)n + 1, spec, va2);
+      err = pf_write_utf8(ub, heap, n);
+      free(heap);
+    }
+  }
+
+  va_end(va2);
+  return err;
+}
+
+static bool pf_length_is(const pf_spec_t *spec, const char *len)
+{
+  return !strcmp(spec->length, len);
+}
+
+static utf_error_t pf_write_int(utfbuf_t *ub, const pf_spec_t *spec,
+    const char *fmt, va_list *ap)
+{
+  const bool is_signed = spec->conv == 'd' || spec->conv == 'i';
+
+  if (pf_length_is(spec, "l"))
+    return is_signed ? pf_snprintf(ub, fmt, va_arg(*ap, long))
+      : pf_snprintf(ub, fmt, va_arg(*ap, unsigned long));
+  if (pf_length_is(spec, "ll"))
+    return is_signed ? pf_snprintf(ub, fmt, va_arg(*ap, long long))
+      : pf_snprintf(ub, fmt, va_arg(*ap, unsigned long long));
+  if (pf_length_is(spec, "z"))
+    return pf_snprintf(ub, fmt, va_arg(*ap, size_t));
+  if (pf_length_is(spec, "j"))
+    return is_signed ? pf_snprintf(ub, fmt, va_arg(*ap, intmax_t))
+      : pf_snprintf(ub, fmt, va_arg(*ap, uintmax_t));
+  if (pf_length_is(spec, "t"))
+    return pf_snprintf(ub, fmt, va_arg(*ap, ptrdiff_t));
+
+  // hh, h and none are all promoted to int.
+  return is_signed ? pf_snprintf(ub, fmt, va_arg(*ap, int))
+    : pf_snprintf(ub, fmt, va_arg(*ap, unsigned));
+}
+
+// Parse a decimal width or precision, flagging values past INT_MAX.
+static int pf_parse_int(const char **p, pf_spec_t *spec)
+{
+  int n = 0;
+  for (; **p >= '0' && **p <= '9'; (*p)++) {
+    const int d = **p - '0';
+    if (n > (INT_MAX - d) / 10)
+      spec->overflow = true;
+    else
+      n = 10 * n + d;
+  }
+
+  return n;
+}
+
+static const char *pf_parse(const char *p, pf_spec_t *spec, va_list *ap)
+{
+  *spec = (pf_spec_t){ .width = -1, .prec = -1 };
+
+  size_t n_flags = 0;
+  while (*p && strchr("-0+ #", *p)) {
+    if (n_flags + 1 < sizeof(spec->flags))
+      spec->flags[n_flags++] = *p;
+    spec->left |= *p == '-';
+    p++;
+  }
+
+  if (*p == '*') {
+    spec->width = va_arg(*ap, int);
+    if (spec->width == INT_MIN) {
+      spec->overflow = true;
+      spec->width = 0;
+    } else if (spec->width < 0) {
+      spec->left = true;
+      spec->width = -spec->width;
+      if (n_flags + 1 < sizeof(spec->flags))
+        spec->flags[n_flags++] = '-';
+    }
+    p++;
+  } else if (*p >= '0' && *p <= '9') {
+    spec->width = pf_parse_int(&p, spec);
+  }
+
+  if (*p == '.') {
+    p++;
+    if (*p == '*') {
+      spec->prec = va_arg(*ap, int);
+      if (spec->prec < 0)
+        spec->prec = -1;
+      p++;
+    } else {
+      spec->prec = pf_parse_int(&p, spec);
+    }
+  }
+
+  static const char *lengths[] = {
+    "hh", "ll", "h", "l", "z", "j", "t", "L",
+  };
+  for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    const size_t n = strlen(lengths[i]);
+    if (!strncmp(p, lengths[i], n)) {
+      memcpy(spec->length, lengths[i], n);
+      p += n;
+      break;
+    }
+  }
+
+  spec->conv = *p;
+  return *p ? p + 1 : p;
+}
+
+// Rebuild a C library conversion spec with '*' arguments resolved.
+static void pf_c_spec(const pf_spec_t *spec, char *out, size_t size)
+{
+  int n = snprintf(out, size, "%%%s", spec->flags);
+  if (spec->width >= 0)
+    n += snprintf(out + n, size - n, "%d", spec->width);
+  if (spec->prec >= 0)
+    n += snprintf(out + n, size - n, ".%d", spec->prec);
+  snprintf(out + n, size - n, "%s%c", spec->length, spec->conv);
+}
+
+static utf_error_t pf_conversion(utfbuf_t *ub, const pf_spec_t *spec,
+    va_list *ap)
+{
+  char fmt[48];
+
+  if (spec->overflow)
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  switch (spec->conv) {
+    case '%':
+      return utfbuf_write_ascii(ub, "%", 1);
+    case 'c':
+      return pf_write_char(ub, spec, va_arg(*ap, unsigned));
+    case 's': {
+      utf_enc_t enc = UTF_8;
+      if (pf_length_is(spec, "h"))
+        enc = UTF_16;
+      else if (pf_length_is(spec, "l"))
+        enc = UTF_32;
+
+      const void *str = va_arg(*ap, const void *);
+      if (!str) {
+        str = "(null)";
+        enc = UTF_8;
+      }
+      return pf_write_str(ub, spec, str, pf_unit_strlen(str, enc), enc);
+    }
+    case 'S': {
+      const utf_strarg_t arg = va_arg(*ap, utf_strarg_t);
+      return pf_write_str(ub, spec, arg.mem, arg.len, arg.enc);
+    }
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      pf_c_spec(spec, fmt, sizeof(fmt));
+      return pf_write_int(ub, spec, fmt, ap);
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      pf_c_spec(spec, fmt, sizeof(fmt));
+      if (pf_length_is(spec, "L"))
+        return pf_snprintf(ub, fmt, va_arg(*ap, long double));
+      return pf_snprintf(ub, fmt, va_arg(*ap, double));
+    case 'p':
+      pf_c_spec(spec, fmt, sizeof(fmt));
+      return pf_snprintf(ub, fmt, va_arg(*ap, void *));
+    default:
+      return UTF_ERROR_INVALID_ARGUMENT;
+  }
+}
+
+utf_error_t utfbuf_vprintf(utfbuf_t *ub, const char *fmt, va_list va)
+{
+  va_list ap;
+  va_copy(ap, va);
+
+  utf_error_t err = UTF_ERROR_SUCCESS;
+  const char *p = fmt;
+
+  while (*p && !utfbuf_truncated(ub)) {
+    const char *pct = strchr(p, '%');
+    const size_t run = pct ? (size_t)(pct - p) : strlen(p);
+
+    if (run) {
+      if ((err = pf_write_utf8(ub, p, run)))
+        break;
+      p += run;
+      continue;
+    }
+
+    pf_spec_t spec;
+    p = pf_parse(p + 1, &spec, &ap);
+    if ((err = pf_conversion(ub, &spec, &ap)))
+      break;
+  }
+
+  va_end(ap);
+  return err;
+}
+
+utf_error_t utfbuf_printf(utfbuf_t *ub, const char *fmt, ...)
+{
+  va_list va;
+  va_start(va, fmt);
+  const utf_error_t err = utfbuf_vprintf(ub, fmt, va);
+  va_end(va);
+  return err;
+}
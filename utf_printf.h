@@ -0,0 +1,36 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+
+// printf-style formatting straight into a utfbuf_t of any encoding.
+//
+// The format string is UTF-8. Numeric conversions behave as in the C
+// library. String and character conversions take text in any
+// encoding, and their width and precision count codepoints rather
+// than bytes:
+//
+//   %s   const char *      UTF-8, null-terminated
+//   %hs  const uint16_t *  UTF-16, null-terminated
+//   %ls  const uint32_t *  UTF-32, null-terminated
+//   %S   utf_strarg_t      explicit (mem, len, enc); see UTF_STRARG
+//   %c   int               a codepoint
+//
+// Overflow follows the usual utfbuf rules: a counting buffer (NULL,
+// 0) accumulates the exact size required, while a real buffer stops
+// once it is full and holds a prefix of the output. %n is not
+// supported.
+
+typedef struct {
+  const void *mem;
+  size_t len; // bytes
+  utf_enc_t enc;
+} utf_strarg_t;
+
+#define UTF_STRARG(mem, len, enc) ((utf_strarg_t){ (mem), (len), (enc) })
+
+utf_error_t utfbuf_printf(utfbuf_t *ub, const char *fmt, ...);
+
+utf_error_t utfbuf_vprintf(utfbuf_t *ub, const char *fmt, va_list va);
@@ -0,0 +1,87 @@
+#include "utf_props.h"
+#include "utf_props_table.h"
+#include "utf_codec.h"
+#include "utf_simd.h"
+#include "macros.h"
+#include "minmax.h"
+
+utf_category_t utf_cp_category(uint32_t cp)
+{
+  return (utf_category_t)utf_category_lookup(cp);
+}
+
+utf_script_t utf_cp_script(uint32_t cp)
+{
+  return (utf_script_t)utf_script_lookup(cp);
+}
+
+const char *utf_category_name(utf_category_t gc)
+{
+  if ((unsigned)gc >= ARRAY_LENGTH(utf_category_names))
+    return NULL;
+  return utf_category_names[gc];
+}
+
+const char *utf_script_name(utf_script_t sc)
+{
+  if ((unsigned)sc >= ARRAY_LENGTH(utf_script_names))
+    return NULL;
+  return utf_script_names[sc];
+}
+
+static inline uint8_t prop_lookup(utf_prop_t prop, uint32_t cp)
+{
+  return prop == UTF_PROP_SCRIPT ? utf_script_lookup(cp) :
+    utf_category_lookup(cp);
+}
+
+// Inlined once per property, so that the lookups in the loop are
+// direct.
+static inline utf_error_t classify(const uint8_t *p, size_t len,
+    utf_enc_t enc, utf_prop_t prop, uint8_t *out, size_t cap, size_t *n)
+{
+  const uint8_t *ascii = prop == UTF_PROP_SCRIPT ?
+    utf_script_ascii : utf_category_ascii;
+  size_t count = 0;
+  size_t i = 0;
+
+  while (i < len) {
+    if (enc == UTF_8 && i + UTF_SIMD_WIDTH <= len &&
+        !utf_simd_high_mask(p + i)) {
+      // A whole vector of ASCII: one table load per byte.
+      const size_t room = min_zu(UTF_SIMD_WIDTH, cap - min_zu(cap, count));
+      for (size_t j = 0; j < room; j++)
+        out[count + j] = ascii[p[i + j]];
+      count += UTF_SIMD_WIDTH;
+      i += UTF_SIMD_WIDTH;
+      continue;
+    }
+
+    uint32_t cp;
+    const size_t k = utf_decode(p + i, len - i, enc, &cp);
+    if (!k) {
+      *n = count;
+      return UTF_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (count < cap)
+      out[count] = cp < 0x80 ? ascii[cp] : prop_lookup(prop, cp);
+    count++;
+    i += k;
+  }
+
+  *n = count;
+  return UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utf_classify(const void *mem, size_t len, utf_enc_t enc,
+    utf_prop_t prop, uint8_t *out, size_t cap, size_t *n)
+{
+  switch (prop) {
+    case UTF_PROP_CATEGORY:
+      return classify(mem, len, enc, UTF_PROP_CATEGORY, out, cap, n);
+    case UTF_PROP_SCRIPT:
+      return classify(mem, len, enc, UTF_PROP_SCRIPT, out, cap, n);
+  }
+  return UTF_ERROR_INVALID_ARGUMENT;
+}
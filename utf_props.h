@@ -0,0 +1,88 @@
+#pragma once
+
+#include "utf_buffer.h"
+#include "utf_scripts.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Unicode general category and script properties, looked up in
+// multi-stage tables generated at build time from the files in ucd/.
+
+// General category. The order is fixed by ucdgen.py.
+typedef enum {
+  UTF_GC_CN = 0,  // unassigned
+  UTF_GC_LU,
+  UTF_GC_LL,
+  UTF_GC_LT,
+  UTF_GC_LM,
+  UTF_GC_LO,
+  UTF_GC_MN,
+  UTF_GC_MC,
+  UTF_GC_ME,
+  UTF_GC_ND,
+  UTF_GC_NL,
+  UTF_GC_NO,
+  UTF_GC_PC,
+  UTF_GC_PD,
+  UTF_GC_PS,
+  UTF_GC_PE,
+  UTF_GC_PI,
+  UTF_GC_PF,
+  UTF_GC_PO,
+  UTF_GC_SM,
+  UTF_GC_SC,
+  UTF_GC_SK,
+  UTF_GC_SO,
+  UTF_GC_ZS,
+  UTF_GC_ZL,
+  UTF_GC_ZP,
+  UTF_GC_CC,
+  UTF_GC_CF,
+  UTF_GC_CS,
+  UTF_GC_CO,
+  UTF_GC_COUNT
+} utf_category_t;
+
+// Category groups, as bitmasks over utf_category_t.
+#define UTF_GC_MASK(gc) (1u << (gc))
+#define UTF_GC_LETTER \
+  (UTF_GC_MASK(UTF_GC_LU) | UTF_GC_MASK(UTF_GC_LL) | \
+   UTF_GC_MASK(UTF_GC_LT) | UTF_GC_MASK(UTF_GC_LM) | UTF_GC_MASK(UTF_GC_LO))
+#define UTF_GC_MARK \
+  (UTF_GC_MASK(UTF_GC_MN) | UTF_GC_MASK(UTF_GC_MC) | UTF_GC_MASK(UTF_GC_ME))
+#define UTF_GC_NUMBER \
+  (UTF_GC_MASK(UTF_GC_ND) | UTF_GC_MASK(UTF_GC_NL) | UTF_GC_MASK(UTF_GC_NO))
+#define UTF_GC_PUNCTUATION \
+  (UTF_GC_MASK(UTF_GC_PC) | UTF_GC_MASK(UTF_GC_PD) | \
+   UTF_GC_MASK(UTF_GC_PS) | UTF_GC_MASK(UTF_GC_PE) | \
+   UTF_GC_MASK(UTF_GC_PI) | UTF_GC_MASK(UTF_GC_PF) | UTF_GC_MASK(UTF_GC_PO))
+#define UTF_GC_SYMBOL \
+  (UTF_GC_MASK(UTF_GC_SM) | UTF_GC_MASK(UTF_GC_SC) | \
+   UTF_GC_MASK(UTF_GC_SK) | UTF_GC_MASK(UTF_GC_SO))
+#define UTF_GC_SEPARATOR \
+  (UTF_GC_MASK(UTF_GC_ZS) | UTF_GC_MASK(UTF_GC_ZL) | UTF_GC_MASK(UTF_GC_ZP))
+#define UTF_GC_OTHER \
+  (UTF_GC_MASK(UTF_GC_CN) | UTF_GC_MASK(UTF_GC_CC) | \
+   UTF_GC_MASK(UTF_GC_CF) | UTF_GC_MASK(UTF_GC_CS) | UTF_GC_MASK(UTF_GC_CO))
+
+typedef enum {
+  UTF_PROP_CATEGORY = 0,
+  UTF_PROP_SCRIPT = 1,
+} utf_prop_t;
+
+// Values outside the codespace are unassigned, of unknown script.
+utf_category_t utf_cp_category(uint32_t cp);
+utf_script_t utf_cp_script(uint32_t cp);
+
+// Short alias ("Lu") and script name ("Old_Italic"), or NULL if out of
+// range.
+const char *utf_category_name(utf_category_t gc);
+const char *utf_script_name(utf_script_t sc);
+
+// Classify every codepoint of the text by prop, writing one value per
+// codepoint to out. *n receives the number of codepoints; if it
+// exceeds cap, only the first cap values are written, so a NULL out
+// with cap 0 measures.
+utf_error_t utf_classify(const void *mem, size_t len, utf_enc_t enc,
+    utf_prop_t prop, uint8_t *out, size_t cap, size_t *n);
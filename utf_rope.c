@@ -0,0 +1,282 @@
+#include "utf_rope.h"
+#include "utf_codec.h"
+#include "minmax.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+struct utf_rope_chunk {
+  size_t refs;
+  utfbuf_t ub;
+  uint8_t data[];
+};
+
+static bool rope_valid_enc(utf_enc_t enc)
+{
+  switch (enc) {
+  case UTF_8:
+  case UTF_16:
+  case UTF_32:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static utf_rope_chunk_t *rope_chunk_new(const utf_alloc_t *alloc,
+    utf_enc_t enc)
+{
+  utf_rope_chunk_t *chunk = utf_realloc(alloc, NULL,
+      sizeof(*chunk) + UTF_ROPE_CHUNK_SIZE);
+  if (!chunk)
+    return NULL;
+
+  chunk->refs = 1;
+  utfbuf_init(&chunk->ub, chunk->data, UTF_ROPE_CHUNK_SIZE, enc);
+  return chunk;
+}
+
+static void rope_chunk_unref(const utf_alloc_t *alloc,
+    utf_rope_chunk_t *chunk)
+{
+  if (!--chunk->refs)
+    utf_free(alloc, chunk);
+}
+
+// Bytes which can still be written to the chunk. The utfbuf's pos is
+// already past the null terminator, so this is exact.
+static size_t rope_chunk_room(const utf_rope_chunk_t *chunk)
+{
+  return chunk->ub.size - chunk->ub.pos;
+}
+
+utf_error_t utf_rope_init(utf_rope_t *rope, utf_enc_t enc,
+    const utf_alloc_t *alloc)
+{
+  if (!rope_valid_enc(enc))
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  *rope = (utf_rope_t){
+    .enc = enc,
+    .alloc = alloc,
+  };
+
+  return UTF_ERROR_SUCCESS;
+}
+
+void utf_rope_free(utf_rope_t *rope)
+{
+  for (size_t i = 0; i < rope->n_pieces; i++)
+    rope_chunk_unref(rope->alloc, rope->pieces[i].chunk);
+
+  utf_free(rope->alloc, rope->pieces);
+  utf_rope_init(rope, rope->enc, rope->alloc);
+}
+
+// Add a piece to the end of the rope, taking over the caller's
+// reference to piece.chunk.
+static utf_error_t rope_push_piece(utf_rope_t *rope,
+    utf_rope_piece_t piece)
+{
+  if (rope->n_pieces) {
+    utf_rope_piece_t *last = &rope->pieces[rope->n_pieces - 1];
+    if (last->chunk == piece.chunk
+        && last->off + last->len == piece.off) {
+      last->len += piece.len;
+      last->cps += piece.cps;
+      rope->len += piece.len;
+      rope->cps += piece.cps;
+      rope_chunk_unref(rope->alloc, piece.chunk);
+      return UTF_ERROR_SUCCESS;
+    }
+  }
+
+  if (rope->n_pieces == rope->cap_pieces) {
+    const size_t cap = rope->cap_pieces ? 2 * rope->cap_pieces : 8;
+    utf_rope_piece_t *pieces = utf_realloc(rope->alloc, rope->pieces,
+        cap * sizeof(*pieces));
+    if (!pieces) {
+      rope_chunk_unref(rope->alloc, piece.chunk);
+      return UTF_ERROR_FAILURE;
+    }
+
+    rope->pieces = pieces;
+    rope->cap_pieces = cap;
+  }
+
+  rope->pieces[rope->n_pieces++] = piece;
+  rope->len += piece.len;
+  rope->cps += piece.cps;
+  return UTF_ERROR_SUCCESS;
+}
+
+// The chunk appends can go into: the last piece's chunk, provided
+// nothing else shares it and the piece runs to the chunk's end.
+static utf_rope_chunk_t *rope_tail_chunk(const utf_rope_t *rope)
+{
+  if (!rope->n_pieces)
+    return NULL;
+
+  const utf_rope_piece_t *last = &rope->pieces[rope->n_pieces - 1];
+  if (last->chunk->refs != 1
+      || last->off + last->len != utfbuf_length(&last->chunk->ub))
+    return NULL;
+
+  return last->chunk;
+}
+
+utf_error_t utf_rope_append(utf_rope_t *rope,
+    const void *mem, size_t len, utf_enc_t enc)
+{
+  if (!rope_valid_enc(enc) || len % utf_bytes(enc))
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  const uint8_t *p = mem;
+  utf_error_t err = UTF_ERROR_SUCCESS;
+
+  // The run of text written to the current chunk so far.
+  utf_rope_piece_t run = { .chunk = rope_tail_chunk(rope) };
+  if (run.chunk) {
+    run.chunk->refs++;
+    run.off = utfbuf_length(&run.chunk->ub);
+  }
+
+  for (size_t i = 0; i < len; ) {
+    uint32_t cp;
+    const size_t n = utf_decode(p + i, len - i, enc, &cp);
+    if (!n) {
+      err = UTF_ERROR_INVALID_ARGUMENT;
+      break;
+    }
+
+    const size_t need = utf_encoded_size(cp, rope->enc);
+    if (!run.chunk || rope_chunk_room(run.chunk) < need) {
+      if (run.chunk) {
+        err = rope_push_piece(rope, run);
+        run.chunk = NULL;
+        if (err)
+          return err;
+      }
+
+      run = (utf_rope_piece_t){
+        .chunk = rope_chunk_new(rope->alloc, rope->enc),
+      };
+      if (!run.chunk)
+        return UTF_ERROR_FAILURE;
+    }
+
+    utfbuf_write_utf32(&run.chunk->ub, cp);
+    run.len += need;
+    run.cps++;
+    i += n;
+  }
+
+  if (!run.chunk)
+    return err;
+
+  const utf_error_t push_err = rope_push_piece(rope, run);
+  return err ? err : push_err;
+}
+
+static utf_error_t rope_append_piece(utf_rope_t *dst, utf_enc_t enc,
+    utf_rope_piece_t piece)
+{
+  if (!piece.len)
+    return UTF_ERROR_SUCCESS;
+
+  if (dst->enc != enc) {
+    return utf_rope_append(dst, piece.chunk->data + piece.off,
+        piece.len, enc);
+  }
+
+  piece.chunk->refs++;
+  return rope_push_piece(dst, piece);
+}
+
+utf_error_t utf_rope_concat(utf_rope_t *dst, const utf_rope_t *src)
+{
+  // Index rather than iterate by pointer: dst may be src.
+  const size_t n = src->n_pieces;
+  for (size_t i = 0; i < n; i++) {
+    const utf_error_t err = rope_append_piece(dst, src->enc,
+        src->pieces[i]);
+    if (err)
+      return err;
+  }
+
+  return UTF_ERROR_SUCCESS;
+}
+
+// Byte offset of the k-th codepoint in [p, p+len).
+static size_t rope_cp_offset(const uint8_t *p, size_t len,
+    utf_enc_t enc, size_t k)
+{
+  size_t off = 0;
+
+  switch (enc) {
+    case UTF_8:
+      for (; off < len; off++) {
+        if ((p[off] & 0xc0) != 0x80 && !k--)
+          break;
+      }
+      return off;
+    case UTF_16:
+      for (; off < len; off += 2) {
+        const uint16_t cu = utf_load16(p + off);
+        if ((cu < 0xDC00 || cu > 0xDFFF) && !k--)
+          break;
+      }
+      return off;
+    default:
+      return min_zu(4 * k, len);
+  }
+}
+
+utf_error_t utf_rope_slice(utf_rope_t *dst, const utf_rope_t *src,
+    size_t cp_start, size_t cp_count)
+{
+  const size_t n = src->n_pieces;
+  for (size_t i = 0; i < n && cp_count; i++) {
+    utf_rope_piece_t piece = src->pieces[i];
+    if (cp_start >= piece.cps) {
+      cp_start -= piece.cps;
+      continue;
+    }
+
+    const uint8_t *data = piece.chunk->data + piece.off;
+    const size_t take = min_zu(piece.cps - cp_start, cp_count);
+    const size_t begin = rope_cp_offset(data, piece.len, src->enc,
+        cp_start);
+    const size_t end = rope_cp_offset(data, piece.len, src->enc,
+        cp_start + take);
+
+    piece.off += begin;
+    piece.len = end - begin;
+    piece.cps = take;
+
+    const utf_error_t err = rope_append_piece(dst, src->enc, piece);
+    if (err)
+      return err;
+
+    cp_start = 0;
+    cp_count -= take;
+  }
+
+  return UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utf_rope_flatten(const utf_rope_t *rope, utfbuf_t *ub)
+{
+  for (size_t i = 0; i < rope->n_pieces; i++) {
+    const utf_rope_piece_t *piece = &rope->pieces[i];
+    const utf_error_t err = utfbuf_write(ub,
+        piece->chunk->data + piece->off, piece->len, rope->enc);
+    if (err)
+      return err;
+
+    if (utfbuf_truncated(ub))
+      break;
+  }
+
+  return UTF_ERROR_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "utf_alloc.h"
+#include "utf_buffer.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// A rope of text in a single encoding, built from fixed-size chunks
+// each written through a utfbuf_t. Appends transcode from any
+// encoding into the tail chunk; concatenation and slicing share
+// chunks between ropes rather than copying text.
+
+#define UTF_ROPE_CHUNK_SIZE 4096
+
+typedef struct utf_rope_chunk utf_rope_chunk_t;
+
+// A contiguous run of text within a chunk.
+typedef struct {
+  utf_rope_chunk_t *chunk;
+  size_t off; // bytes
+  size_t len; // bytes
+  size_t cps; // codepoints
+} utf_rope_piece_t;
+
+typedef struct {
+  utf_enc_t enc;
+  const utf_alloc_t *alloc;
+
+  utf_rope_piece_t *pieces;
+  size_t n_pieces;
+  size_t cap_pieces;
+
+  size_t len; // bytes
+  size_t cps; // codepoints
+} utf_rope_t;
+
+utf_error_t utf_rope_init(utf_rope_t *rope, utf_enc_t enc,
+    const utf_alloc_t *alloc);
+
+void utf_rope_free(utf_rope_t *rope);
+
+// Append enc-encoded text, transcoding into the rope's encoding. On
+// malformed input the valid prefix is kept and
+// UTF_ERROR_INVALID_ARGUMENT is returned.
+utf_error_t utf_rope_append(utf_rope_t *rope,
+    const void *mem, size_t len, utf_enc_t enc);
+
+// Append the contents of src to dst. When the encodings match no text
+// is copied; src's chunks are shared.
+utf_error_t utf_rope_concat(utf_rope_t *dst, const utf_rope_t *src);
+
+// Append cp_count codepoints of src, starting at codepoint cp_start,
+// to dst. The range is clamped to the end of src. Like concat, this
+// shares chunks when the encodings match.
+utf_error_t utf_rope_slice(utf_rope_t *dst, const utf_rope_t *src,
+    size_t cp_start, size_t cp_count);
+
+// Write the whole rope into ub, in ub's encoding.
+utf_error_t utf_rope_flatten(const utf_rope_t *rope, utfbuf_t *ub);
+
+static inline size_t utf_rope_length(const utf_rope_t *rope)
+{
+  return rope->len;
+}
+
+static inline size_t utf_rope_codepoints(const utf_rope_t *rope)
+{
+  return rope->cps;
+}
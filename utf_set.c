@@ -0,0 +1,252 @@
+#include "utf_set.h"
+#include "utf_codec.h"
+#include "utf_simd.h"
+#include "minmax.h"
+
+#include <string.h>
+
+void utf_set_init(utf_set_t *set, const utf_alloc_t *alloc)
+{
+  *set = (utf_set_t){ .alloc = alloc };
+}
+
+void utf_set_free(utf_set_t *set)
+{
+  utf_free(set->alloc, set->ranges);
+  utf_set_init(set, set->alloc);
+}
+
+// Index of the first range which ends at or after cp.
+static size_t set_lower_bound(const utf_set_t *set, uint32_t cp)
+{
+  size_t lo = 0, hi = set->n_ranges;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (set->ranges[mid].last < cp)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static utf_error_t set_insert(utf_set_t *set, uint32_t first,
+    uint32_t last)
+{
+  // Ranges [i, j) overlap or touch the new one and merge into it.
+  const size_t i = set_lower_bound(set, first ? first - 1 : 0);
+  size_t j = i;
+  while (j < set->n_ranges && set->ranges[j].first <= last + 1) {
+    first = min_u32(first, set->ranges[j].first);
+    last = max_u32(last, set->ranges[j].last);
+    j++;
+  }
+
+  if (i == j) {
+    if (set->n_ranges == set->cap_ranges) {
+      const size_t cap = set->cap_ranges ? set->cap_ranges * 2 : 16;
+      utf_range_t *ranges = utf_realloc(set->alloc, set->ranges,
+          cap * sizeof(*ranges));
+      if (!ranges)
+        return UTF_ERROR_FAILURE;
+      set->ranges = ranges;
+      set->cap_ranges = cap;
+    }
+    memmove(set->ranges + i + 1, set->ranges + i,
+        (set->n_ranges - i) * sizeof(*set->ranges));
+    set->n_ranges++;
+    j = i + 1;
+  }
+
+  set->ranges[i] = (utf_range_t){ first, last };
+  memmove(set->ranges + i + 1, set->ranges + j,
+      (set->n_ranges - j) * sizeof(*set->ranges));
+  set->n_ranges -= j - i - 1;
+  return UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utf_set_add_range(utf_set_t *set, uint32_t first,
+    uint32_t last)
+{
+  if (first > last)
+    return UTF_ERROR_INVALID_ARGUMENT;
+  if (first > 0x10FFFF)
+    return UTF_ERROR_SUCCESS;
+  last = min_u32(last, 0x10FFFF);
+
+  for (uint32_t cp = first; cp <= last && cp < 0x80; cp++)
+    set->ascii[cp & 0xf] |= 1u << (cp >> 4);
+
+  if (last < 0x80)
+    return UTF_ERROR_SUCCESS;
+  return set_insert(set, max_u32(first, 0x80), last);
+}
+
+utf_error_t utf_set_add_ranges(utf_set_t *set,
+    const utf_range_t *ranges, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    const utf_error_t err = utf_set_add_range(set,
+        ranges[i].first, ranges[i].last);
+    if (err)
+      return err;
+  }
+  return UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utf_set_add_chars(utf_set_t *set,
+    const void *mem, size_t len, utf_enc_t enc)
+{
+  const uint8_t *p = mem;
+  size_t i = 0;
+
+  while (i < len) {
+    uint32_t cp;
+    const size_t k = utf_decode(p + i, len - i, enc, &cp);
+    if (!k)
+      return UTF_ERROR_INVALID_ARGUMENT;
+
+    const utf_error_t err = utf_set_add_range(set, cp, cp);
+    if (err)
+      return err;
+    i += k;
+  }
+  return UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utf_set_add_predicate(utf_set_t *set,
+    bool (*pred)(uint32_t cp, void *ctx), void *ctx)
+{
+  // Runs are added whole, and always at the end of what this call has
+  // added so far, so building is linear in the number of runs.
+  uint32_t cp = 0;
+  while (cp < 0x110000) {
+    if (!pred(cp, ctx)) {
+      cp++;
+      continue;
+    }
+
+    const uint32_t first = cp;
+    while (cp < 0x110000 && pred(cp, ctx))
+      cp++;
+
+    const utf_error_t err = utf_set_add_range(set, first, cp - 1);
+    if (err)
+      return err;
+  }
+  return UTF_ERROR_SUCCESS;
+}
+
+static bool set_in_categories(uint32_t cp, void *ctx)
+{
+  return UTF_GC_MASK(utf_cp_category(cp)) & *(const uint32_t *)ctx;
+}
+
+utf_error_t utf_set_add_categories(utf_set_t *set, uint32_t gc_mask)
+{
+  return utf_set_add_predicate(set, set_in_categories, &gc_mask);
+}
+
+static bool set_in_script(uint32_t cp, void *ctx)
+{
+  return utf_cp_script(cp) == *(const utf_script_t *)ctx;
+}
+
+utf_error_t utf_set_add_script(utf_set_t *set, utf_script_t sc)
+{
+  return utf_set_add_predicate(set, set_in_script, &sc);
+}
+
+bool utf_set_contains(const utf_set_t *set, uint32_t cp)
+{
+  if (cp < 0x80)
+    return (set->ascii[cp & 0xf] >> (cp >> 4)) & 1;
+
+  const size_t i = set_lower_bound(set, cp);
+  return i < set->n_ranges && set->ranges[i].first <= cp;
+}
+
+// Mask of the next 16 code units at p which need a closer look: for a
+// span, those not known to be ASCII members; for a cspan, those not
+// known to be ASCII non-members.
+static inline uint32_t set_block_mask(const uint8_t *p, utf_enc_t enc,
+    const utf_set_t *set, bool member)
+{
+  uint8_t tmp[UTF_SIMD_WIDTH];
+  const uint8_t *b = utf_simd_narrow(p, enc, tmp);
+
+  const uint32_t in = utf_simd_set_mask(b, set->ascii);
+  if (member)
+    return ~in & 0xffff;
+  return in | utf_simd_high_mask(b);
+}
+
+// Offset of the first codepoint whose membership is not member.
+static utf_error_t set_scan(const void *mem, size_t len, utf_enc_t enc,
+    const utf_set_t *set, bool member, size_t *n)
+{
+  const uint8_t *p = mem;
+  const size_t width = utf_bytes(enc);
+  const size_t block = UTF_SIMD_WIDTH * width;
+  size_t i = 0;
+
+  switch (enc) {
+  case UTF_8:
+  case UTF_16:
+  case UTF_32:
+    break;
+  default:
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+
+  while (i < len) {
+    if (i + block <= len) {
+      const uint32_t mask = set_block_mask(p + i, enc, set, member);
+      if (!mask) {
+        i += block;
+        continue;
+      }
+      i += utf_simd_ctz(mask) * width;
+    }
+
+    // Past ASCII, look codepoints up in the ranges until the block
+    // test can take over again.
+    do {
+      uint32_t cp;
+      const size_t k = utf_decode(p + i, len - i, enc, &cp);
+      if (!k) {
+        *n = i;
+        return UTF_ERROR_INVALID_ARGUMENT;
+      }
+      if (utf_set_contains(set, cp) != member) {
+        *n = i;
+        return UTF_ERROR_SUCCESS;
+      }
+      i += k;
+    } while (i < len && (i + block > len || utf_load_unit(p + i, enc) >= 0x80));
+  }
+
+  *n = len;
+  return UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utf_span(const void *mem, size_t len, utf_enc_t enc,
+    const utf_set_t *set, size_t *n)
+{
+  return set_scan(mem, len, enc, set, true, n);
+}
+
+utf_error_t utf_cspan(const void *mem, size_t len, utf_enc_t enc,
+    const utf_set_t *set, size_t *n)
+{
+  return set_scan(mem, len, enc, set, false, n);
+}
+
+utf_error_t utf_find_in_set(const void *mem, size_t len, utf_enc_t enc,
+    const utf_set_t *set, size_t *offset)
+{
+  const utf_error_t err = utf_cspan(mem, len, enc, set, offset);
+  if (!err && *offset == len)
+    *offset = UTF_NPOS;
+  return err;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "utf_alloc.h"
+#include "utf_buffer.h"
+#include "utf_props.h"
+#include "utf_str.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// A set of codepoints, for scanning text for the first character in
+// (or not in) the set. ASCII membership is kept as a nibble table
+// which is tested 16 bytes at a time; everything above is a sorted
+// list of disjoint ranges, searched by bisection. Sets are built by
+// adding ranges or property predicates and are read-only while
+// scanning, so one set may be shared between threads.
+
+typedef struct {
+  uint32_t first;
+  uint32_t last; // inclusive
+} utf_range_t;
+
+typedef struct {
+  // Bit h of ascii[l] is set iff codepoint (h << 4) | l is a member.
+  uint8_t ascii[16];
+
+  // Members above U+007F.
+  utf_range_t *ranges;
+  size_t n_ranges;
+  size_t cap_ranges;
+
+  const utf_alloc_t *alloc;
+} utf_set_t;
+
+void utf_set_init(utf_set_t *set, const utf_alloc_t *alloc);
+
+void utf_set_free(utf_set_t *set);
+
+// Add [first, last]. Values past U+10FFFF are ignored.
+utf_error_t utf_set_add_range(utf_set_t *set, uint32_t first,
+    uint32_t last);
+
+utf_error_t utf_set_add_ranges(utf_set_t *set,
+    const utf_range_t *ranges, size_t n);
+
+// Add each codepoint of a string, e.g. " \t\r\n".
+utf_error_t utf_set_add_chars(utf_set_t *set,
+    const void *mem, size_t len, utf_enc_t enc);
+
+// Add every codepoint for which pred returns true. This visits the
+// whole codespace, so is meant for building sets once, up front.
+utf_error_t utf_set_add_predicate(utf_set_t *set,
+    bool (*pred)(uint32_t cp, void *ctx), void *ctx);
+
+// Add every codepoint whose general category is in gc_mask, a union of
+// UTF_GC_MASK() values such as UTF_GC_LETTER.
+utf_error_t utf_set_add_categories(utf_set_t *set, uint32_t gc_mask);
+
+utf_error_t utf_set_add_script(utf_set_t *set, utf_script_t sc);
+
+bool utf_set_contains(const utf_set_t *set, uint32_t cp);
+
+// Length in bytes of the longest prefix of the text made of members
+// (utf_span) or non-members (utf_cspan). On malformed input, *n is
+// the offset of the bad sequence and UTF_ERROR_INVALID_ARGUMENT is
+// returned.
+utf_error_t utf_span(const void *mem, size_t len, utf_enc_t enc,
+    const utf_set_t *set, size_t *n);
+
+utf_error_t utf_cspan(const void *mem, size_t len, utf_enc_t enc,
+    const utf_set_t *set, size_t *n);
+
+// Byte offset of the first member in the text, or UTF_NPOS if there
+// is none.
+utf_error_t utf_find_in_set(const void *mem, size_t len, utf_enc_t enc,
+    const utf_set_t *set, size_t *offset);
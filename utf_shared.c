@@ -0,0 +1,149 @@
+#include "utf_shared.h"
+
+#include <string.h>
+
+// Record header. state is zero until the record is committed, then
+// holds the distance to the next header along with SB_COMMITTED. A
+// reservation which straddles the end of the buffer leaves SB_END
+// behind instead, so readers know nothing follows.
+typedef struct {
+  _Atomic uint32_t state;
+  uint32_t len;
+} sb_header_t;
+
+#define SB_COMMITTED 0x80000000u
+#define SB_END 0x40000000u
+#define SB_STRIDE_MASK 0x3fffffffu
+
+#define SB_ALIGN sizeof(sb_header_t)
+
+static size_t sb_align_up(size_t n)
+{
+  return (n + SB_ALIGN - 1) & ~(SB_ALIGN - 1);
+}
+
+static sb_header_t *sb_header(utf_sharedbuf_t *sb, size_t off)
+{
+  return (sb_header_t *)(sb->start + off);
+}
+
+utf_error_t utf_sharedbuf_init(utf_sharedbuf_t *sb,
+    void *mem, size_t mem_size, utf_enc_t encoding)
+{
+  switch (encoding) {
+  case UTF_8:
+  case UTF_16:
+  case UTF_32:
+    break;
+  default:
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Headers are accessed atomically, so must be aligned.
+  const size_t skip = sb_align_up((uintptr_t)mem) - (uintptr_t)mem;
+  sb->start = mem;
+  sb->size = 0;
+  if (mem_size > skip) {
+    sb->start += skip;
+    sb->size = (mem_size - skip) & ~(SB_ALIGN - 1);
+    memset(sb->start, 0, sb->size);
+  }
+  sb->enc = encoding;
+  atomic_init(&sb->pos, 0);
+  atomic_init(&sb->overflow, 0);
+  return UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utf_sharedbuf_reserve(utf_sharedbuf_t *sb, size_t size,
+    utf_shared_record_t *rec)
+{
+  rec->header = NULL;
+  utfbuf_init(&rec->ub, NULL, 0, sb->enc);
+
+  if (size < utf_bytes(sb->enc) || size > SB_STRIDE_MASK - SB_ALIGN * 2)
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  const size_t stride = sb_align_up(sizeof(sb_header_t) + size);
+
+  // Once full, stay full without pushing pos any further.
+  if (atomic_load_explicit(&sb->pos, memory_order_relaxed) >= sb->size) {
+    atomic_fetch_add_explicit(&sb->overflow, size, memory_order_relaxed);
+    return UTF_ERROR_FAILURE;
+  }
+
+  const size_t off = atomic_fetch_add_explicit(&sb->pos, stride,
+      memory_order_relaxed);
+  if (off >= sb->size || sb->size - off < stride) {
+    if (off < sb->size) {
+      atomic_store_explicit(&sb_header(sb, off)->state, SB_END,
+          memory_order_release);
+    }
+    atomic_fetch_add_explicit(&sb->overflow, size, memory_order_relaxed);
+    return UTF_ERROR_FAILURE;
+  }
+
+  rec->header = sb->start + off;
+  rec->stride = (uint32_t)stride;
+  utfbuf_init(&rec->ub, rec->header + sizeof(sb_header_t), size, sb->enc);
+  return UTF_ERROR_SUCCESS;
+}
+
+void utf_sharedbuf_commit(utf_sharedbuf_t *sb, utf_shared_record_t *rec)
+{
+  if (!rec->header)
+    return;
+
+  const size_t dropped = utfbuf_overflow(&rec->ub);
+  if (dropped) {
+    atomic_fetch_add_explicit(&sb->overflow, dropped,
+        memory_order_relaxed);
+  }
+
+  sb_header_t *hdr = (sb_header_t *)rec->header;
+  hdr->len = (uint32_t)utfbuf_length(&rec->ub);
+  atomic_store_explicit(&hdr->state, rec->stride | SB_COMMITTED,
+      memory_order_release);
+  rec->header = NULL;
+}
+
+utf_error_t utf_sharedbuf_append(utf_sharedbuf_t *sb,
+    const void *mem, size_t len, utf_enc_t enc)
+{
+  utfbuf_t counter;
+  utfbuf_init(&counter, NULL, 0, sb->enc);
+  utf_error_t err = utfbuf_write(&counter, mem, len, enc);
+  if (err)
+    return err;
+
+  utf_shared_record_t rec;
+  err = utf_sharedbuf_reserve(sb, utfbuf_overflow(&counter), &rec);
+  if (err)
+    return err;
+
+  utfbuf_write(&rec.ub, mem, len, enc);
+  utf_sharedbuf_commit(sb, &rec);
+  return UTF_ERROR_SUCCESS;
+}
+
+bool utf_sharedbuf_next(utf_sharedbuf_t *sb, size_t *cursor,
+    const void **mem, size_t *len)
+{
+  if (*cursor >= sb->size)
+    return false;
+
+  sb_header_t *hdr = sb_header(sb, *cursor);
+  const uint32_t state = atomic_load_explicit(&hdr->state,
+      memory_order_acquire);
+  if (!(state & SB_COMMITTED))
+    return false;
+
+  *mem = hdr + 1;
+  *len = hdr->len;
+  *cursor += state & SB_STRIDE_MASK;
+  return true;
+}
+
+size_t utf_sharedbuf_overflow(utf_sharedbuf_t *sb)
+{
+  return atomic_load_explicit(&sb->overflow, memory_order_relaxed);
+}
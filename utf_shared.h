@@ -0,0 +1,64 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// A buffer of records appended concurrently by many producers without
+// a lock. A producer measures its record with a counting utfbuf, then
+// reserves that many bytes with a single fetch-add and transcodes into
+// its own range while other producers do the same. Each record is
+// preceded by a small header which the producer publishes last, so a
+// reader walking the buffer only ever sees complete records, in
+// reservation order.
+//
+// When a reservation does not fit, it fails and its size is counted as
+// overflow; the buffer is then full and every later reservation fails
+// too. Reset with utf_sharedbuf_init once all producers are done.
+
+typedef struct {
+  uint8_t *start;
+  size_t size;
+  utf_enc_t enc;
+
+  _Atomic size_t pos;
+  _Atomic size_t overflow;
+} utf_sharedbuf_t;
+
+// A reserved range, written through ub.
+typedef struct {
+  utfbuf_t ub;
+  uint8_t *header;
+  uint32_t stride;
+} utf_shared_record_t;
+
+utf_error_t utf_sharedbuf_init(utf_sharedbuf_t *sb,
+    void *mem, size_t mem_size, utf_enc_t encoding);
+
+// Reserve a record of size bytes, as measured by the overflow of a
+// counting utfbuf (so including the null terminator), and point
+// rec->ub at it. Returns UTF_ERROR_FAILURE if the buffer is full; rec
+// may still be committed, which does nothing.
+utf_error_t utf_sharedbuf_reserve(utf_sharedbuf_t *sb, size_t size,
+    utf_shared_record_t *rec);
+
+// Publish a record. Anything written past its reserved size was
+// dropped and is counted as overflow.
+void utf_sharedbuf_commit(utf_sharedbuf_t *sb, utf_shared_record_t *rec);
+
+// Measure, reserve, write and commit len bytes of enc-encoded text as
+// one record.
+utf_error_t utf_sharedbuf_append(utf_sharedbuf_t *sb,
+    const void *mem, size_t len, utf_enc_t enc);
+
+// Read the record at *cursor (0 for the first) and advance past it.
+// Returns false when that record is not committed yet, or at the end
+// of the buffer. The text is null-terminated; len excludes the
+// terminator.
+bool utf_sharedbuf_next(utf_sharedbuf_t *sb, size_t *cursor,
+    const void **mem, size_t *len);
+
+// Bytes of records which did not fit.
+size_t utf_sharedbuf_overflow(utf_sharedbuf_t *sb);
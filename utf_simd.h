@@ -0,0 +1,328 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Minimal 16-byte vector helpers. Each returns a bitmask with bit i
+// set for lane i. SSE2 is used where available; otherwise a scalar
+// loop computes the same mask, so callers never need to special-case
+// the fallback.
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define UTF_SIMD_SSE2 1
+#endif
+
+#define UTF_SIMD_WIDTH 16
+
+// Lanes where a[i] == x and b[i] == y.
+static inline uint32_t utf_simd_eq2_mask(const uint8_t *a,
+    const uint8_t *b, uint8_t x, uint8_t y)
+{
+#if UTF_SIMD_SSE2
+  const __m128i va = _mm_loadu_si128((const __m128i *)a);
+  const __m128i vb = _mm_loadu_si128((const __m128i *)b);
+  const __m128i m = _mm_and_si128(
+      _mm_cmpeq_epi8(va, _mm_set1_epi8((char)x)),
+      _mm_cmpeq_epi8(vb, _mm_set1_epi8((char)y)));
+  return (uint32_t)_mm_movemask_epi8(m);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++)
+    mask |= (uint32_t)(a[i] == x && b[i] == y) << i;
+  return mask;
+#endif
+}
+
+// Lanes with the top bit set (i.e. non-ASCII bytes).
+static inline uint32_t utf_simd_high_mask(const uint8_t *p)
+{
+#if UTF_SIMD_SSE2
+  const __m128i v = _mm_loadu_si128((const __m128i *)p);
+  return (uint32_t)_mm_movemask_epi8(v);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++)
+    mask |= (uint32_t)(p[i] >> 7) << i;
+  return mask;
+#endif
+}
+
+// Lanes holding a UTF-8 continuation byte (10xxxxxx).
+static inline uint32_t utf_simd_cont_mask(const uint8_t *p)
+{
+#if UTF_SIMD_SSE2
+  // Continuation bytes are exactly the signed bytes < -64.
+  const __m128i v = _mm_loadu_si128((const __m128i *)p);
+  const __m128i m = _mm_cmplt_epi8(v, _mm_set1_epi8((char)0xc0));
+  return (uint32_t)_mm_movemask_epi8(m);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++)
+    mask |= (uint32_t)((p[i] & 0xc0) == 0x80) << i;
+  return mask;
+#endif
+}
+
+static inline unsigned utf_simd_popcount(uint32_t mask)
+{
+  return (unsigned)__builtin_popcount(mask);
+}
+
+static inline unsigned utf_simd_ctz(uint32_t mask)
+{
+  return (unsigned)__builtin_ctz(mask);
+}
+
+#if UTF_SIMD_SSE2
+// Prepare code units for narrowing to bytes: ASCII units keep their
+// value, anything else becomes 0x00ff in each 16-bit half, which the
+// packs saturate to 0xff. Packing the raw units is not enough, since
+// the packs treat them as signed and would map 0x8000-0xffff to 0.
+static inline __m128i utf_simd_clamp_ascii(__m128i v, __m128i ascii)
+{
+  return _mm_or_si128(_mm_and_si128(v, ascii),
+      _mm_andnot_si128(ascii, _mm_set1_epi16(0xff)));
+}
+#endif
+
+// Narrow 16 UTF-16 code units (32 bytes) at b16 to 16 bytes at out:
+// ASCII units are kept, all others become 0xff.
+static inline void utf_simd_narrow16(const uint8_t *b16, uint8_t *out)
+{
+#if UTF_SIMD_SSE2
+  const __m128i high = _mm_set1_epi16((short)0xff80);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_loadu_si128((const __m128i *)b16);
+  __m128i hi = _mm_loadu_si128((const __m128i *)(b16 + 16));
+  lo = utf_simd_clamp_ascii(lo,
+      _mm_cmpeq_epi16(_mm_and_si128(lo, high), zero));
+  hi = utf_simd_clamp_ascii(hi,
+      _mm_cmpeq_epi16(_mm_and_si128(hi, high), zero));
+  _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(lo, hi));
+#else
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++) {
+    uint16_t u;
+    memcpy(&u, b16 + 2*i, 2);
+    out[i] = u < 0x80 ? (uint8_t)u : 0xff;
+  }
+#endif
+}
+
+// As utf_simd_narrow16, for 16 UTF-32 code units (64 bytes).
+static inline void utf_simd_narrow32(const uint8_t *b32, uint8_t *out)
+{
+#if UTF_SIMD_SSE2
+  const __m128i high = _mm_set1_epi32((int)0xffffff80);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i v[4];
+  for (int k = 0; k < 4; k++) {
+    v[k] = _mm_loadu_si128((const __m128i *)(b32 + 16*k));
+    v[k] = utf_simd_clamp_ascii(v[k],
+        _mm_cmpeq_epi32(_mm_and_si128(v[k], high), zero));
+  }
+  const __m128i lo = _mm_packs_epi32(v[0], v[1]);
+  const __m128i hi = _mm_packs_epi32(v[2], v[3]);
+  _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(lo, hi));
+#else
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++) {
+    uint32_t u;
+    memcpy(&u, b32 + 4*i, 4);
+    out[i] = u < 0x80 ? (uint8_t)u : 0xff;
+  }
+#endif
+}
+
+// The next 16 code units at p as bytes with the high bit set exactly
+// on the non-ASCII units: p itself for byte encodings, otherwise tmp
+// filled by utf_simd_narrow16 or utf_simd_narrow32.
+static inline const uint8_t *utf_simd_narrow(const uint8_t *p,
+    utf_enc_t enc, uint8_t *tmp)
+{
+  switch (utf_bytes(enc)) {
+    case 2:
+      utf_simd_narrow16(p, tmp);
+      return tmp;
+    case 4:
+      utf_simd_narrow32(p, tmp);
+      return tmp;
+    default:
+      return p;
+  }
+}
+
+// Lanes where a[i] is ASCII and equal to the i-th UTF-16 code unit of
+// b16 (which holds 16 code units, i.e. 32 bytes).
+static inline uint32_t utf_simd_ascii_eq_u8_u16_mask(const uint8_t *a,
+    const uint8_t *b16)
+{
+  uint8_t b[UTF_SIMD_WIDTH];
+  utf_simd_narrow16(b16, b);
+  // Non-ASCII units narrow to 0xff, which never equals an ASCII byte.
+#if UTF_SIMD_SSE2
+  const __m128i va = _mm_loadu_si128((const __m128i *)a);
+  const __m128i vb = _mm_loadu_si128((const __m128i *)b);
+  const uint32_t eq = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+  return eq & ~(uint32_t)_mm_movemask_epi8(va) & 0xffff;
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++)
+    mask |= (uint32_t)(a[i] < 0x80 && a[i] == b[i]) << i;
+  return mask;
+#endif
+}
+
+// Lanes which need attention in a JSON string body: '"', '\\',
+// control characters (< 0x20) and non-ASCII bytes.
+static inline uint32_t utf_simd_json_mask(const uint8_t *p)
+{
+#if UTF_SIMD_SSE2
+  const __m128i v = _mm_loadu_si128((const __m128i *)p);
+  // As signed bytes, both controls and non-ASCII are < 0x20.
+  const __m128i m = _mm_or_si128(
+      _mm_cmplt_epi8(v, _mm_set1_epi8(0x20)),
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+  return (uint32_t)_mm_movemask_epi8(m);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++) {
+    const uint8_t b = p[i];
+    mask |= (uint32_t)(b < 0x20 || b >= 0x80
+        || b == '"' || b == '\\') << i;
+  }
+  return mask;
+#endif
+}
+
+// Lanes which are not printable ASCII (0x20-0x7e).
+static inline uint32_t utf_simd_nonprint_mask(const uint8_t *p)
+{
+#if UTF_SIMD_SSE2
+  const __m128i v = _mm_loadu_si128((const __m128i *)p);
+  // As signed bytes, controls and non-ASCII are both < 0x20.
+  const __m128i m = _mm_or_si128(
+      _mm_cmplt_epi8(v, _mm_set1_epi8(0x20)),
+      _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)));
+  return (uint32_t)_mm_movemask_epi8(m);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++)
+    mask |= (uint32_t)(p[i] < 0x20 || p[i] >= 0x7f) << i;
+  return mask;
+#endif
+}
+
+// Store 16 ASCII bytes from src as 16 code units of the given width
+// (1, 2 or 4 bytes each, native order) at dst.
+static inline void utf_simd_widen(const uint8_t *src, uint8_t *dst,
+    unsigned width)
+{
+#if UTF_SIMD_SSE2
+  const __m128i v = _mm_loadu_si128((const __m128i *)src);
+  const __m128i zero = _mm_setzero_si128();
+  if (width == 1) {
+    _mm_storeu_si128((__m128i *)dst, v);
+  } else if (width == 2) {
+    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(v, zero));
+    _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi8(v, zero));
+  } else {
+    const __m128i lo = _mm_unpacklo_epi8(v, zero);
+    const __m128i hi = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *)(dst + 32), _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128((__m128i *)(dst + 48), _mm_unpackhi_epi16(hi, zero));
+  }
+#else
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++) {
+    const uint32_t u = src[i];
+    if (width == 1)
+      dst[i] = src[i];
+    else if (width == 2)
+      memcpy(dst + 2*i, &(uint16_t){ (uint16_t)u }, 2);
+    else
+      memcpy(dst + 4*i, &u, 4);
+  }
+#endif
+}
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define UTF_SIMD_SSSE3 1
+#define UTF_SIMD_TARGET_SSSE3
+#elif UTF_SIMD_SSE2 && defined(__GNUC__)
+// SSSE3 is not in the x86-64 baseline, but nearly every CPU has it:
+// build the shuffles for it anyway and check for it at run time.
+#include <tmmintrin.h>
+#define UTF_SIMD_SSSE3 1
+#define UTF_SIMD_SSSE3_DISPATCH 1
+#define UTF_SIMD_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+// Reference form of utf_simd_set_mask, one lane at a time.
+static inline uint32_t utf_simd_set_mask_scalar(const uint8_t *p,
+    const uint8_t *table)
+{
+  uint32_t mask = 0;
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++) {
+    const uint8_t b = p[i];
+    mask |= (uint32_t)(b < 0x80 && (table[b & 0xf] >> (b >> 4)) & 1) << i;
+  }
+  return mask;
+}
+
+#if UTF_SIMD_SSSE3
+static inline UTF_SIMD_TARGET_SSSE3 uint32_t utf_simd_set_mask_ssse3(
+    const uint8_t *p, const uint8_t *table)
+{
+  const __m128i v = _mm_loadu_si128((const __m128i *)p);
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  const __m128i rows = _mm_shuffle_epi8(
+      _mm_loadu_si128((const __m128i *)table), _mm_and_si128(v, nibble));
+  // 1 << h for the high nibble h, and 0 for h >= 8 (non-ASCII).
+  const __m128i bits = _mm_shuffle_epi8(
+      _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0),
+      _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+  const __m128i miss = _mm_cmpeq_epi8(_mm_and_si128(rows, bits),
+      _mm_setzero_si128());
+  return ~(uint32_t)_mm_movemask_epi8(miss) & 0xffff;
+}
+#endif
+
+// Lanes holding an ASCII byte in a set of ASCII characters, given as
+// a nibble table: bit h of table[l] is set iff byte (h << 4) | l is in
+// the set. Non-ASCII lanes are never members. With SSSE3 this is two
+// shuffles and no per-lane work.
+static inline uint32_t utf_simd_set_mask(const uint8_t *p,
+    const uint8_t *table)
+{
+#if UTF_SIMD_SSSE3_DISPATCH
+  if (__builtin_cpu_supports("ssse3"))
+    return utf_simd_set_mask_ssse3(p, table);
+  return utf_simd_set_mask_scalar(p, table);
+#elif UTF_SIMD_SSSE3
+  return utf_simd_set_mask_ssse3(p, table);
+#else
+  return utf_simd_set_mask_scalar(p, table);
+#endif
+}
+
+// Store the 16 bytes at p with ASCII A-Z lowered to a-z.
+static inline void utf_simd_ascii_lower(const uint8_t *p, uint8_t *out)
+{
+#if UTF_SIMD_SSE2
+  const __m128i v = _mm_loadu_si128((const __m128i *)p);
+  const __m128i upper = _mm_and_si128(
+      _mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+      _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+  _mm_storeu_si128((__m128i *)out,
+      _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+#else
+  for (int i = 0; i < UTF_SIMD_WIDTH; i++)
+    out[i] = p[i] + ((p[i] >= 'A' && p[i] <= 'Z') ? 0x20 : 0);
+#endif
+}
@@ -0,0 +1,312 @@
+#include "utf_str.h"
+#include "utf_codec.h"
+#include "utf_simd.h"
+#include "minmax.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+static bool str_valid_enc(utf_enc_t enc)
+{
+  switch (enc) {
+  case UTF_8:
+  case UTF_16:
+  case UTF_32:
+    return true;
+  default:
+    return false;
+  }
+}
+
+size_t utf_count_codepoints(const void *mem, size_t len, utf_enc_t enc)
+{
+  const uint8_t *p = mem;
+  size_t n = 0;
+  size_t i = 0;
+
+  switch (enc) {
+    case UTF_8:
+      for (; i + UTF_SIMD_WIDTH <= len; i += UTF_SIMD_WIDTH)
+        n += UTF_SIMD_WIDTH - utf_simd_popcount(utf_simd_cont_mask(p + i));
+      for (; i < len; i++)
+        n += (p[i] & 0xc0) != 0x80;
+      return n;
+    case UTF_16:
+      for (; i + 2 <= len; i += 2) {
+        const uint16_t cu = utf_load16(p + i);
+        n += cu < 0xDC00 || cu > 0xDFFF;
+      }
+      return n;
+    case UTF_32:
+      return len / 4;
+    default:
+      return 0;
+  }
+}
+
+// Is off the start of a codepoint (or the end of the text)?
+static bool str_is_boundary(const uint8_t *p, size_t len,
+    utf_enc_t enc, size_t off)
+{
+  if (off % utf_bytes(enc))
+    return false;
+
+  if (off == len)
+    return true;
+
+  switch (enc) {
+    case UTF_8:
+      return (p[off] & 0xc0) != 0x80;
+    case UTF_16: {
+      const uint16_t cu = utf_load16(p + off);
+      return cu < 0xDC00 || cu > 0xDFFF;
+    }
+    default:
+      return true;
+  }
+}
+
+static bool str_match_at(const uint8_t *hay, size_t hlen,
+    const uint8_t *nd, size_t nlen, utf_enc_t enc, size_t at)
+{
+  return !memcmp(hay + at, nd, nlen)
+    && str_is_boundary(hay, hlen, enc, at)
+    && str_is_boundary(hay, hlen, enc, at + nlen);
+}
+
+// Byte-level search for nd in hay, same encoding, nlen > 0.
+// Candidates are filtered 16 at a time on the needle's first and
+// last bytes before the full comparison.
+static size_t str_find_raw(const uint8_t *hay, size_t hlen,
+    const uint8_t *nd, size_t nlen, utf_enc_t enc)
+{
+  if (nlen > hlen)
+    return UTF_NPOS;
+
+  const uint8_t first = nd[0];
+  const uint8_t last = nd[nlen-1];
+  const size_t n_starts = hlen - nlen + 1;
+  size_t i = 0;
+
+  for (; i + UTF_SIMD_WIDTH <= n_starts; i += UTF_SIMD_WIDTH) {
+    uint32_t mask = utf_simd_eq2_mask(hay + i, hay + i + nlen - 1,
+        first, last);
+    while (mask) {
+      const size_t at = i + utf_simd_ctz(mask);
+      if (str_match_at(hay, hlen, nd, nlen, enc, at))
+        return at;
+      mask &= mask - 1;
+    }
+  }
+
+  for (; i < n_starts; i++) {
+    if (hay[i] == first && hay[i + nlen - 1] == last
+        && str_match_at(hay, hlen, nd, nlen, enc, i))
+      return i;
+  }
+
+  return UTF_NPOS;
+}
+
+utf_error_t utf_find(const void *haystack, size_t hlen, utf_enc_t henc,
+    const void *needle, size_t nlen, utf_enc_t nenc,
+    utf_unit_t unit, size_t *offset)
+{
+  if (!str_valid_enc(henc) || !str_valid_enc(nenc))
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  if (hlen % utf_bytes(henc) || nlen % utf_bytes(nenc))
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  const uint8_t *nd = needle;
+  size_t nd_len = nlen;
+  uint8_t *heap = NULL;
+
+  // Short needles (the common case) are transcoded on the stack.
+  UTFBUF_DEFINE_LOCAL(ub, 256, henc);
+
+  if (nenc != henc) {
+    // Transcode the needle into the haystack's encoding.
+    utf_error_t err = utfbuf_write(&ub, needle, nlen, nenc);
+    if (err)
+      return err;
+
+    if (utfbuf_overflow(&ub)) {
+      utfbuf_t counter;
+      utfbuf_init(&counter, NULL, 0, henc);
+      err = utfbuf_write(&counter, needle, nlen, nenc);
+      if (err)
+        return err;
+      if (counter.in.enc)
+        return UTF_ERROR_INVALID_ARGUMENT;
+
+      const size_t required = utfbuf_overflow(&counter);
+      heap = malloc(required);
+      if (!heap)
+        return UTF_ERROR_FAILURE;
+
+      utfbuf_init(&ub, heap, required, henc);
+      err = utfbuf_write(&ub, needle, nlen, nenc);
+      if (err) {
+        free(heap);
+        return err;
+      }
+    }
+
+    if (ub.in.enc) {
+      // Needle ends mid-codepoint.
+      free(heap);
+      return UTF_ERROR_INVALID_ARGUMENT;
+    }
+
+    nd = heap ? heap : ub_storage;
+    nd_len = utfbuf_length(&ub);
+  }
+
+  size_t at = 0;
+  if (nd_len)
+    at = str_find_raw(haystack, hlen, nd, nd_len, henc);
+
+  free(heap);
+
+  if (at != UTF_NPOS && unit == UTF_UNIT_CODEPOINTS)
+    at = utf_count_codepoints(haystack, at, henc);
+
+  *offset = at;
+  return UTF_ERROR_SUCCESS;
+}
+
+static int str_order(size_t x, size_t y)
+{
+  return (x > y) - (x < y);
+}
+
+// UTF-16 code units do not sort in codepoint order: surrogates
+// (D800-DFFF) must sort above E000-FFFF. Rotate them into place.
+static uint32_t str_utf16_sort_key(uint16_t cu)
+{
+  if (cu >= 0xE000)
+    return cu - 0x800;
+  if (cu >= 0xD800)
+    return cu + 0x2000;
+  return cu;
+}
+
+static int str_compare_same(const uint8_t *a, size_t alen,
+    const uint8_t *b, size_t blen, utf_enc_t enc)
+{
+  const size_t len = min_zu(alen, blen);
+  const uint8_t width = utf_bytes(enc);
+
+  if (enc == UTF_8) {
+    // UTF-8 byte order is codepoint order.
+    const int r = memcmp(a, b, len);
+    return r ? r : str_order(alen, blen);
+  }
+
+  for (size_t i = 0; i < len; i += width) {
+    uint32_t x = utf_load_unit(a + i, enc);
+    uint32_t y = utf_load_unit(b + i, enc);
+    if (x == y)
+      continue;
+
+    if (enc == UTF_16) {
+      x = str_utf16_sort_key(x);
+      y = str_utf16_sort_key(y);
+    }
+    return str_order(x, y);
+  }
+
+  return str_order(alen, blen);
+}
+
+// Number of leading codepoints which are ASCII and equal in both
+// texts. No decoding is needed: an ASCII code unit is a codepoint in
+// every encoding.
+static size_t str_ascii_lockstep(const uint8_t *a, size_t alen,
+    utf_enc_t aenc, const uint8_t *b, size_t blen, utf_enc_t benc)
+{
+  if (aenc == UTF_16 && benc == UTF_8)
+    return str_ascii_lockstep(b, blen, benc, a, alen, aenc);
+
+  const uint8_t wa = utf_bytes(aenc);
+  const uint8_t wb = utf_bytes(benc);
+  const size_t n = min_zu(alen / wa, blen / wb);
+  size_t i = 0;
+
+  if (aenc == UTF_8 && benc == UTF_16) {
+    for (; i + UTF_SIMD_WIDTH <= n; i += UTF_SIMD_WIDTH) {
+      const uint32_t eq = utf_simd_ascii_eq_u8_u16_mask(a + i, b + 2*i);
+      if (eq != 0xffff)
+        return i + utf_simd_ctz(~eq);
+    }
+  }
+
+  for (; i < n; i++) {
+    const uint32_t x = utf_load_unit(a + i*wa, aenc);
+    if (x >= 0x80 || x != utf_load_unit(b + i*wb, benc))
+      break;
+  }
+
+  return i;
+}
+
+utf_error_t utf_compare(const void *a, size_t alen, utf_enc_t aenc,
+    const void *b, size_t blen, utf_enc_t benc, int *order)
+{
+  if (!str_valid_enc(aenc) || !str_valid_enc(benc))
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  const uint8_t wa = utf_bytes(aenc);
+  const uint8_t wb = utf_bytes(benc);
+  if (alen % wa || blen % wb)
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  const uint8_t *pa = a;
+  const uint8_t *pb = b;
+
+  if (aenc == benc) {
+    *order = str_compare_same(pa, alen, pb, blen, aenc);
+    return UTF_ERROR_SUCCESS;
+  }
+
+  size_t i = 0, j = 0;
+  for (;;) {
+    const size_t n = str_ascii_lockstep(pa + i, alen - i, aenc,
+        pb + j, blen - j, benc);
+    i += n * wa;
+    j += n * wb;
+
+    if (i == alen || j == blen)
+      break;
+
+    // First divergence (or non-ASCII): decode one codepoint each.
+    uint32_t ca, cb;
+    const size_t na = utf_decode(pa + i, alen - i, aenc, &ca);
+    const size_t nb = utf_decode(pb + j, blen - j, benc, &cb);
+    if (!na || !nb)
+      return UTF_ERROR_INVALID_ARGUMENT;
+
+    if (ca != cb) {
+      *order = str_order(ca, cb);
+      return UTF_ERROR_SUCCESS;
+    }
+
+    i += na;
+    j += nb;
+  }
+
+  *order = (i < alen) - (j < blen);
+  return UTF_ERROR_SUCCESS;
+}
+
+bool utf_equal(const void *a, size_t alen, utf_enc_t aenc,
+    const void *b, size_t blen, utf_enc_t benc)
+{
+  if (aenc == benc && str_valid_enc(aenc))
+    return alen == blen && !memcmp(a, b, alen);
+
+  int order;
+  return !utf_compare(a, alen, aenc, b, blen, benc, &order) && !order;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Operations over borrowed, already-encoded text. Text is passed as
+// (mem, len, enc) where len is a length in bytes.
+
+#define UTF_NPOS ((size_t)-1)
+
+typedef enum {
+  UTF_UNIT_BYTES = 0,
+  UTF_UNIT_CODEPOINTS = 1,
+} utf_unit_t;
+
+// Number of codepoints in the text. The text is assumed to be valid.
+size_t utf_count_codepoints(const void *mem, size_t len, utf_enc_t enc);
+
+// Find the first occurrence of needle in haystack. The needle is
+// transcoded (once) into the haystack's encoding; the haystack itself
+// is never transcoded. Matches are only reported at codepoint
+// boundaries. On success *offset is the match position in the given
+// unit, or UTF_NPOS if there is no match.
+utf_error_t utf_find(const void *haystack, size_t hlen, utf_enc_t henc,
+    const void *needle, size_t nlen, utf_enc_t nenc,
+    utf_unit_t unit, size_t *offset);
+
+// Compare two texts in codepoint order, setting *order to a negative
+// value, zero, or a positive value. Texts in different encodings are
+// compared in lockstep without transcoding; only codepoints past the
+// common ASCII prefix are decoded. Malformed input encountered while
+// decoding is reported as UTF_ERROR_INVALID_ARGUMENT. Texts in the same
+// encoding are compared by code unit and are not validated.
+utf_error_t utf_compare(const void *a, size_t alen, utf_enc_t aenc,
+    const void *b, size_t blen, utf_enc_t benc, int *order);
+
+// Codepoint-wise equality. Texts in the same encoding are compared
+// bytewise, malformed or not; otherwise malformed text compares
+// unequal.
+bool utf_equal(const void *a, size_t alen, utf_enc_t aenc,
+    const void *b, size_t blen, utf_enc_t benc);
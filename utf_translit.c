@@ -0,0 +1,28 @@
+#include "utf_translit.h"
+#include "utf_translit_table.h"
+
+// Spellings of ASCII itself, so that every spelling is a pointer into
+// static storage.
+static const char translit_ascii[128] = {
+#define R(i) i, i+1, i+2, i+3, i+4, i+5, i+6, i+7
+  R(0), R(8), R(16), R(24), R(32), R(40), R(48), R(56),
+  R(64), R(72), R(80), R(88), R(96), R(104), R(112), R(120),
+#undef R
+};
+
+bool utf_cp_translit(uint32_t cp, const char **ascii, size_t *n)
+{
+  if (cp < 0x80) {
+    *ascii = translit_ascii + cp;
+    *n = 1;
+    return true;
+  }
+
+  const uint16_t row = utf_translit_lookup(cp);
+  if (!row)
+    return false;
+
+  *ascii = utf_translit_pool + utf_translit_rows[row][0];
+  *n = utf_translit_rows[row][1];
+  return true;
+}
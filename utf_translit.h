@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// ASCII transliteration, as used to normalise text for search
+// indexing: diacritics are dropped, and letters, ligatures and
+// compatibility forms are spelled in ASCII ("é" to "e", "ß" to "ss",
+// "ﬁ" to "fi", "①" to "1"). Characters with no ASCII spelling, such
+// as CJK, are left alone. See also utfbuf_set_translit.
+
+// Look up the ASCII spelling of cp, returning it in *ascii (not null
+// terminated) and its length in *n. Combining diacritics have an empty
+// spelling. Returns false if cp has no spelling. ASCII spells itself.
+bool utf_cp_translit(uint32_t cp, const char **ascii, size_t *n);
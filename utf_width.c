@@ -0,0 +1,173 @@
+#include "utf_width.h"
+#include "utf_width_table.h"
+#include "utf_codec.h"
+#include "utf_simd.h"
+#include "minmax.h"
+
+#include <stdbool.h>
+
+#define ZWJ 0x200D
+#define VS15 0xFE0E
+#define VS16 0xFE0F
+
+// Context carried from one codepoint to the next.
+typedef struct {
+  uint8_t prev;   // table entry of the last non-zero-width codepoint
+  uint8_t prev_w; // its width, after any presentation selector
+  bool zwj;       // just seen ZWJ after a pictograph
+} dw_state_t;
+
+int utf_cp_width(uint32_t cp)
+{
+  return utf_width_lookup(cp) & 0x3;
+}
+
+static bool dw_is_skin_tone(uint32_t cp)
+{
+  return cp >= 0x1F3FB && cp <= 0x1F3FF;
+}
+
+// Columns added by cp. This is -1 when U+FE0E narrows the preceding
+// emoji.
+static int dw_step(dw_state_t *st, uint32_t cp)
+{
+  const uint8_t props = utf_width_lookup(cp);
+
+  if (st->zwj) {
+    st->zwj = false;
+    if (props & UTF_WIDTH_EXT_PICT)
+      return 0; // Part of the preceding emoji.
+  }
+
+  switch (cp) {
+    case ZWJ:
+      st->zwj = !!(st->prev & UTF_WIDTH_EXT_PICT);
+      return 0;
+    case VS16:
+      if ((st->prev & UTF_WIDTH_EMOJI) && st->prev_w == 1) {
+        st->prev_w = 2;
+        return 1;
+      }
+      return 0;
+    case VS15:
+      if ((st->prev & UTF_WIDTH_EMOJI_PRES) && st->prev_w == 2) {
+        st->prev_w = 1;
+        return -1;
+      }
+      return 0;
+  }
+
+  if (dw_is_skin_tone(cp) && (st->prev & UTF_WIDTH_EXT_PICT))
+    return 0;
+
+  const int w = props & 0x3;
+  if (w) {
+    st->prev = props;
+    st->prev_w = w;
+  }
+  return w;
+}
+
+// Length of the run of printable ASCII at the start of [p, p+len).
+static size_t dw_ascii_run(const uint8_t *p, size_t len)
+{
+  size_t i = 0;
+
+  for (; i + UTF_SIMD_WIDTH <= len; i += UTF_SIMD_WIDTH) {
+    const uint32_t mask = utf_simd_nonprint_mask(p + i);
+    if (mask)
+      return i + utf_simd_ctz(mask);
+  }
+
+  while (i < len && p[i] >= 0x20 && p[i] < 0x7f)
+    i++;
+
+  return i;
+}
+
+// Scan as much of the text as fits in max_cols columns, returning the
+// number of bytes consumed and setting *cols to their width.
+static size_t dw_scan(const uint8_t *p, size_t len, utf_enc_t enc,
+    size_t max_cols, size_t *cols, utf_error_t *err)
+{
+  dw_state_t st = { 0 };
+  size_t width = 0;
+  size_t i = 0;
+
+  // Where the last character with a width of its own starts, and the
+  // width before it: a selector that widens it and does not fit takes
+  // it out too.
+  size_t base = 0, base_width = 0;
+
+  *err = UTF_ERROR_SUCCESS;
+
+  while (i < len) {
+    if (enc == UTF_8 && !st.zwj) {
+      // Printable ASCII is one column per byte, no decoding needed.
+      const size_t run = dw_ascii_run(p + i,
+          min_zu(len - i, max_cols - width));
+      if (run) {
+        base = i + run - 1;
+        base_width = width + run - 1;
+        width += run;
+        i += run;
+        st.prev = utf_width_lookup(p[i-1]);
+        st.prev_w = 1;
+        continue;
+      }
+    }
+
+    uint32_t cp;
+    const size_t n = utf_decode(p + i, len - i, enc, &cp);
+    if (!n) {
+      *err = UTF_ERROR_INVALID_ARGUMENT;
+      break;
+    }
+
+    dw_state_t next = st;
+    const int w = dw_step(&next, cp);
+    if (w > 0 && width + w > max_cols) {
+      if (cp == VS16) {
+        i = base;
+        width = base_width;
+      }
+      break;
+    }
+
+    if (w > 0 && cp != VS16) {
+      base = i;
+      base_width = width;
+    }
+
+    st = next;
+    width += w;
+    i += n;
+  }
+
+  *cols = width;
+  return i;
+}
+
+utf_error_t utf_display_width(const void *mem, size_t len, utf_enc_t enc,
+    size_t *width)
+{
+  utf_error_t err;
+  dw_scan(mem, len, enc, SIZE_MAX, width, &err);
+  return err;
+}
+
+utf_error_t utfbuf_write_columns(utfbuf_t *ub,
+    const void *mem, size_t len, utf_enc_t enc,
+    size_t max_cols, size_t *cols)
+{
+  utf_error_t err;
+  size_t width;
+  const size_t n = dw_scan(mem, len, enc, max_cols, &width, &err);
+  if (err)
+    return err;
+
+  if (cols)
+    *cols = width;
+
+  return utfbuf_write(ub, mem, n, enc);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Terminal display width, in columns, following East Asian Width:
+// wide and fullwidth characters take two columns, combining marks,
+// format and control characters none, and everything else one.
+// Emoji sequences are measured as a whole: pictographs joined by
+// ZWJ, skin tone modifiers, and U+FE0F/U+FE0E presentation selectors
+// are accounted for.
+
+// Width of a single codepoint, out of context: 0, 1 or 2.
+int utf_cp_width(uint32_t cp);
+
+utf_error_t utf_display_width(const void *mem, size_t len, utf_enc_t enc,
+    size_t *width);
+
+// Write the longest prefix of the text which fits in max_cols columns,
+// never splitting a wide character or an emoji sequence. If cols is
+// not NULL it receives the width of what was written.
+utf_error_t utfbuf_write_columns(utfbuf_t *ub,
+    const void *mem, size_t len, utf_enc_t enc,
+    size_t max_cols, size_t *cols);
@@ -0,0 +1,334 @@
+#include "utf_words.h"
+#include "utf_words_table.h"
+#include "utf_codec.h"
+#include "utf_simd.h"
+#include "macros.h"
+
+// Rules are numbered as in UAX #29. WB4 makes Extend, Format and ZWJ
+// transparent: the rules from WB5 on see the last character which is
+// not one of those, called the effective class below.
+
+#define WB_NONE 0xff // nothing: start or end of text
+
+// Bit h of table[l] is set iff (h << 4) | l is in [0-9A-Za-z_] (see
+// utf_simd_set_mask).
+static const uint8_t wb_word_chars[16] = {
+  0xa8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8,
+  0xf8, 0xf8, 0xf0, 0x50, 0x50, 0x50, 0x50, 0x70,
+};
+
+// As wb_word_chars, without '_'.
+static const uint8_t wb_alnum_chars[16] = {
+  0xa8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8,
+  0xf8, 0xf8, 0xf0, 0x50, 0x50, 0x50, 0x50, 0x50,
+};
+
+static inline uint8_t wb_props(uint32_t cp)
+{
+  return cp < 0x80 ? utf_wb_ascii[cp] : utf_wb_lookup(cp);
+}
+
+// Decode the character at i, returning its length, or 0 if it is
+// malformed.
+static inline size_t wb_decode(const utf_words_t *it, size_t i,
+    uint8_t *props)
+{
+  uint32_t cp;
+  const size_t k = utf_decode(it->p + i, it->len - i, it->enc, &cp);
+  if (k)
+    *props = wb_props(cp);
+  return k;
+}
+
+static inline bool wb_ignorable(uint8_t wb)
+{
+  return wb == UTF_WB_EXTEND || wb == UTF_WB_FORMAT || wb == UTF_WB_ZWJ;
+}
+
+static inline bool wb_ahletter(uint8_t wb)
+{
+  return wb == UTF_WB_ALETTER || wb == UTF_WB_HEBREW_LETTER;
+}
+
+static inline bool wb_midnumletq(uint8_t wb)
+{
+  return wb == UTF_WB_MIDNUMLET || wb == UTF_WB_SINGLE_QUOTE;
+}
+
+// Effective class of the first character at or after i, for the rules
+// which look one character ahead.
+static uint8_t wb_lookahead(const utf_words_t *it, size_t i)
+{
+  while (i < it->len) {
+    uint8_t props;
+    const size_t k = wb_decode(it, i, &props);
+    if (!k)
+      return WB_NONE;
+    if (!wb_ignorable(props & UTF_WB_MASK))
+      return props & UTF_WB_MASK;
+    i += k;
+  }
+  return WB_NONE;
+}
+
+// Whether there is no boundary between effective classes a and b,
+// where before is the effective class preceding a in the segment, ri
+// is the length of the run of regional indicators ending at a, and
+// next is the offset just past b.
+static bool wb_join(const utf_words_t *it, uint8_t before, uint8_t a,
+    uint8_t b, size_t ri, size_t next)
+{
+  if (wb_ahletter(a)) {
+    if (wb_ahletter(b) || b == UTF_WB_NUMERIC ||
+        b == UTF_WB_EXTENDNUMLET)
+      return true;  // WB5, WB9, WB13a
+    if (a == UTF_WB_HEBREW_LETTER && b == UTF_WB_SINGLE_QUOTE)
+      return true;  // WB7a
+    if (b == UTF_WB_MIDLETTER || wb_midnumletq(b))
+      return wb_ahletter(wb_lookahead(it, next));  // WB6
+    if (a == UTF_WB_HEBREW_LETTER && b == UTF_WB_DOUBLE_QUOTE)
+      return wb_lookahead(it, next) == UTF_WB_HEBREW_LETTER;  // WB7b
+    return false;
+  }
+
+  switch (a) {
+    case UTF_WB_NUMERIC:
+      if (b == UTF_WB_NUMERIC || wb_ahletter(b) ||
+          b == UTF_WB_EXTENDNUMLET)
+        return true;  // WB8, WB10, WB13a
+      if (b == UTF_WB_MIDNUM || wb_midnumletq(b))
+        return wb_lookahead(it, next) == UTF_WB_NUMERIC;  // WB12
+      return false;
+    case UTF_WB_KATAKANA:
+      return b == UTF_WB_KATAKANA || b == UTF_WB_EXTENDNUMLET;  // WB13, WB13a
+    case UTF_WB_EXTENDNUMLET:
+      return wb_ahletter(b) || b == UTF_WB_NUMERIC ||
+        b == UTF_WB_KATAKANA || b == UTF_WB_EXTENDNUMLET;  // WB13a, WB13b
+    case UTF_WB_MIDLETTER:
+      return wb_ahletter(before) && wb_ahletter(b);  // WB7
+    case UTF_WB_MIDNUMLET:
+    case UTF_WB_SINGLE_QUOTE:
+      return (wb_ahletter(before) && wb_ahletter(b)) ||
+        (before == UTF_WB_NUMERIC && b == UTF_WB_NUMERIC);  // WB7, WB11
+    case UTF_WB_MIDNUM:
+      return before == UTF_WB_NUMERIC && b == UTF_WB_NUMERIC;  // WB11
+    case UTF_WB_DOUBLE_QUOTE:
+      return before == UTF_WB_HEBREW_LETTER &&
+        b == UTF_WB_HEBREW_LETTER;  // WB7c
+    case UTF_WB_REGIONAL_INDICATOR:
+      return b == UTF_WB_REGIONAL_INDICATOR && ri % 2;  // WB15, WB16
+    default:
+      return false;  // WB999
+  }
+}
+
+// {{{ ASCII fast paths
+
+static inline bool wb_is_word_unit(uint32_t unit)
+{
+  if (unit >= 0x80)
+    return false;
+  const uint8_t wb = utf_wb_ascii[unit] & UTF_WB_MASK;
+  return wb == UTF_WB_ALETTER || wb == UTF_WB_NUMERIC ||
+    wb == UTF_WB_EXTENDNUMLET;
+}
+
+// Skip ASCII which cannot be part of a word, i.e. everything but
+// [0-9A-Za-z_], from a segment boundary. Every rule which would join
+// such a character to a following word character also joins it to the
+// preceding one, so the end of the run is a boundary too.
+static size_t wb_skip_separators(const utf_words_t *it, size_t i)
+{
+  const size_t width = utf_bytes(it->enc);
+
+  while (i + UTF_SIMD_WIDTH * width <= it->len) {
+    uint8_t tmp[UTF_SIMD_WIDTH];
+    const uint8_t *b = utf_simd_narrow(it->p + i, it->enc, tmp);
+    const uint32_t stop = utf_simd_set_mask(b, wb_word_chars) |
+      utf_simd_high_mask(b);
+    if (stop)
+      return i + utf_simd_ctz(stop) * width;
+    i += UTF_SIMD_WIDTH * width;
+  }
+
+  while (i < it->len) {
+    const uint32_t unit = utf_load_unit(it->p + i, it->enc);
+    if (unit >= 0x80 || wb_is_word_unit(unit))
+      break;
+    i += width;
+  }
+  return i;
+}
+
+// Number of code units in the run of [0-9A-Za-z_] at i, counting
+// whole vectors only. All of it is one segment (WB5, WB8-WB10,
+// WB13a, WB13b). Sets *alnum if the run holds a letter or digit.
+static size_t wb_word_run(const utf_words_t *it, size_t i, bool *alnum)
+{
+  const size_t width = utf_bytes(it->enc);
+  size_t n = 0;
+
+  while (i + UTF_SIMD_WIDTH * width <= it->len) {
+    uint8_t tmp[UTF_SIMD_WIDTH];
+    const uint8_t *b = utf_simd_narrow(it->p + i, it->enc, tmp);
+    const uint32_t other = ~utf_simd_set_mask(b, wb_word_chars) & 0xffff;
+    const size_t run = other ? utf_simd_ctz(other) : UTF_SIMD_WIDTH;
+    const uint32_t in_run = (1u << run) - 1;
+    *alnum |= !!(utf_simd_set_mask(b, wb_alnum_chars) & in_run);
+    n += run;
+    i += run * width;
+    if (run < UTF_SIMD_WIDTH)
+      break;
+  }
+  return n;
+}
+
+// }}}
+
+// Find the end of the segment starting at it->pos, and whether it
+// holds a letter or number. Returns false if the character at it->pos
+// is malformed; a malformed character later on ends the segment.
+static bool wb_segment(const utf_words_t *it, size_t *end, bool *word)
+{
+  const size_t width = utf_bytes(it->enc);
+  size_t i = it->pos;
+  uint8_t props;
+  uint8_t a, raw;
+  uint8_t before = WB_NONE;
+  size_t ri = 0;
+  bool is_word = false;
+
+  const size_t run = wb_word_run(it, i, &is_word);
+  if (run) {
+    // Resume the rules after the run with its last two characters.
+    const uint8_t *q = it->p + i + run * width;
+    a = utf_wb_ascii[utf_load_unit(q - width, it->enc)] & UTF_WB_MASK;
+    if (run > 1) {
+      before = utf_wb_ascii[utf_load_unit(q - 2 * width, it->enc)] &
+        UTF_WB_MASK;
+    }
+    raw = a;
+    i += run * width;
+  } else {
+    const size_t k = wb_decode(it, i, &props);
+    if (!k)
+      return false;
+    a = raw = props & UTF_WB_MASK;
+    ri = a == UTF_WB_REGIONAL_INDICATOR;
+    is_word = props & UTF_WB_WORD;
+    i += k;
+
+    if (a == UTF_WB_CR && i < it->len &&
+        utf_load_unit(it->p + i, it->enc) == '\n')
+      i += width;  // WB3
+    if (a == UTF_WB_CR || a == UTF_WB_LF || a == UTF_WB_NEWLINE) {
+      *end = i;  // WB3a
+      *word = false;
+      return true;
+    }
+  }
+
+  while (i < it->len) {
+    const size_t k = wb_decode(it, i, &props);
+    if (!k)
+      break;
+
+    const uint8_t b = props & UTF_WB_MASK;
+    if (b == UTF_WB_CR || b == UTF_WB_LF || b == UTF_WB_NEWLINE)
+      break;  // WB3b
+
+    const bool join =
+      (raw == UTF_WB_ZWJ && (props & UTF_WB_EXT_PICT)) ||  // WB3c
+      (raw == UTF_WB_WSEGSPACE && b == UTF_WB_WSEGSPACE) ||  // WB3d
+      wb_ignorable(b) ||  // WB4
+      wb_join(it, before, a, b, ri, i + k);
+    if (!join)
+      break;
+
+    if (!wb_ignorable(b)) {
+      before = a;
+      a = b;
+      ri = b == UTF_WB_REGIONAL_INDICATOR ? ri + 1 : 0;
+    }
+    raw = b;
+    is_word |= props & UTF_WB_WORD;
+    i += k;
+  }
+
+  *end = i;
+  *word = is_word;
+  return true;
+}
+
+utf_error_t utf_words_init(utf_words_t *it,
+    const void *mem, size_t len, utf_enc_t enc, unsigned flags)
+{
+  switch (enc) {
+  case UTF_8:
+  case UTF_16:
+  case UTF_32:
+    break;
+  default:
+    return UTF_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (len % utf_bytes(enc))
+    return UTF_ERROR_INVALID_ARGUMENT;
+
+  *it = (utf_words_t){
+    .p = mem,
+    .len = len,
+    .enc = enc,
+    .flags = flags,
+  };
+  return UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utf_words_next(utf_words_t *it,
+    utf_slice_t *out, size_t cap, size_t *n)
+{
+  const bool all = it->flags & UTF_WORDS_ALL;
+  *n = 0;
+
+  while (*n < cap) {
+    if (!all)
+      it->pos = wb_skip_separators(it, it->pos);
+    if (it->pos >= it->len)
+      break;
+
+    size_t end;
+    bool word;
+    if (!wb_segment(it, &end, &word))
+      return UTF_ERROR_INVALID_ARGUMENT;
+
+    if (word || all)
+      out[(*n)++] = (utf_slice_t){ it->pos, end - it->pos };
+    it->pos = end;
+  }
+
+  return UTF_ERROR_SUCCESS;
+}
+
+utf_error_t utf_words_each(const void *mem, size_t len, utf_enc_t enc,
+    unsigned flags, bool (*fn)(utf_slice_t word, void *ctx), void *ctx)
+{
+  utf_words_t it;
+  utf_error_t err = utf_words_init(&it, mem, len, enc, flags);
+  if (err)
+    return err;
+
+  for (;;) {
+    utf_slice_t batch[32];
+    size_t n;
+    err = utf_words_next(&it, batch, ARRAY_LENGTH(batch), &n);
+
+    for (size_t i = 0; i < n; i++) {
+      if (!fn(batch[i], ctx))
+        return UTF_ERROR_SUCCESS;
+    }
+    if (err || !n)
+      return err;
+  }
+}
+
+// vim: foldmethod=marker
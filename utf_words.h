@@ -0,0 +1,49 @@
+#pragma once
+
+#include "utf_buffer.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Word segmentation by the default word boundary rules of UAX #29
+// (Unicode Text Segmentation), over borrowed UTF-8, UTF-16 or UTF-32
+// text. Words are reported as byte slices of the input, which is never
+// copied or transcoded.
+//
+// By default only segments holding a letter or number are reported,
+// so the spaces and punctuation between words are skipped: "can't
+// stop, 3.14" gives "can't", "stop" and "3.14". CJK ideographs are
+// one word each. With UTF_WORDS_ALL every segment is reported, and
+// the slices tile the input.
+
+#define UTF_WORDS_ALL 0x1
+
+typedef struct {
+  size_t offset;
+  size_t len;
+} utf_slice_t;
+
+typedef struct {
+  const uint8_t *p;
+  size_t len;
+  utf_enc_t enc;
+  unsigned flags;
+
+  // Byte offset at which the next segment starts.
+  size_t pos;
+} utf_words_t;
+
+utf_error_t utf_words_init(utf_words_t *it,
+    const void *mem, size_t len, utf_enc_t enc, unsigned flags);
+
+// Store up to cap further words in out, with the number stored in *n;
+// 0 means the end of the text. On malformed input the words before it
+// are stored, it->pos is left at the bad sequence and
+// UTF_ERROR_INVALID_ARGUMENT is returned.
+utf_error_t utf_words_next(utf_words_t *it,
+    utf_slice_t *out, size_t cap, size_t *n);
+
+// Call fn with each word in turn, stopping early if it returns false.
+utf_error_t utf_words_each(const void *mem, size_t len, utf_enc_t enc,
+    unsigned flags, bool (*fn)(utf_slice_t word, void *ctx), void *ctx);